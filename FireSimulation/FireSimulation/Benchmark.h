@@ -0,0 +1,354 @@
+#pragma once
+#include "Simulation.h"
+#include "Headless.h"
+#include <chrono>
+#include <iomanip>
+
+// Enough frames to fill up to the particle cap and let the fire run for a while
+constexpr int BENCHMARK_FRAMES = 1500;
+
+static double RunSolverFrames(Solver& solver, int frames) {
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int frame = 0; frame < frames; frame++) {
+
+		if ((int)solver.GetParticles().size() < solver.GetParticleCap())
+			SpawnEmitters(solver);
+
+		solver.UpdateSolver();
+	}
+
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs the same seeded scene on 1 and on base_config.thread_count threads, in deterministic and in fast mode
+static void RunDeterminismBenchmark(const SolverConfig& base_config) {
+
+	std::vector<int> thread_counts = { 1 };
+
+	if (base_config.thread_count > 1)
+		thread_counts.push_back(base_config.thread_count);
+
+	std::cout << "Determinism benchmark: " << BENCHMARK_FRAMES << " frames, seed " << base_config.seed << '\n';
+
+	uint64_t reference_hash = 0;
+	bool reproducible = true;
+	double best_deterministic = 0.0, best_fast = 0.0;
+
+	for (int thread_count : thread_counts) {
+
+		for (bool deterministic : { true, false }) {
+
+			SolverConfig config = base_config;
+			config.thread_count = thread_count;
+			config.deterministic = deterministic;
+
+			auto solver = std::make_unique<Solver>(config);
+			double ms = RunSolverFrames(*solver, BENCHMARK_FRAMES);
+			uint64_t hash = solver->GetStateHash();
+
+			if (deterministic) {
+
+				if (reference_hash == 0)
+					reference_hash = hash;
+				else if (hash != reference_hash)
+					reproducible = false;
+
+				best_deterministic = best_deterministic == 0.0 ? ms : std::min(best_deterministic, ms);
+			}
+			else {
+
+				best_fast = best_fast == 0.0 ? ms : std::min(best_fast, ms);
+			}
+
+			std::cout << std::setw(3) << thread_count << " threads, " << (deterministic ? "deterministic" : "fast         ")
+				<< ": " << std::fixed << std::setprecision(2) << ms / BENCHMARK_FRAMES << " ms/frame, state hash "
+				<< std::hex << hash << std::dec << '\n';
+		}
+	}
+
+	std::cout << "Deterministic runs " << (reproducible ? "match" : "DIFFER") << " across thread counts\n";
+	std::cout << "Cost of determinism: " << std::setprecision(1) << (best_deterministic / best_fast - 1.0) * 100.0 << "%\n";
+}
+
+// Times UpdateVA on synthetic snapshots of growing size, serially and on base_config.render_thread_count threads
+static void RunVertexBuildBenchmark(const SolverConfig& base_config) {
+
+	constexpr int particle_counts[] = { 1000, 10000, 100000, 1000000 };
+	constexpr int iterations = 20;
+
+	std::vector<int> thread_counts = { 1 };
+
+	if (base_config.render_thread_count > 1)
+		thread_counts.push_back(base_config.render_thread_count);
+
+	auto solver = std::make_unique<Solver>(base_config);
+	Random rng(base_config.seed);
+
+	std::cout << "Vertex build benchmark: " << iterations << " builds per size\n";
+
+	for (int count : particle_counts) {
+
+		RenderSnapshot& snapshot = solver->GetFrontSnapshot();
+		snapshot.positions.resize(count);
+		snapshot.radii.assign(count, PARTICLE_RADIUS);
+		snapshot.temperatures.resize(count);
+		snapshot.particle_count = count;
+		snapshot.filled = count >= MAX_PARTICLES;
+
+		for (int i = 0; i < count; i++) {
+
+			snapshot.positions[i] = { rng.NextFloat() * WORLD_WIDTH, rng.NextFloat() * WORLD_HEIGHT };
+			snapshot.temperatures[i] = rng.NextFloat() * MAX_TEMPERATURE;
+		}
+
+		// First build allocates the vertices, keep it out of the timing
+		solver->UpdateVA();
+
+		for (int thread_count : thread_counts) {
+
+			solver->SetRenderThreadCount(thread_count);
+
+			auto start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < iterations; i++)
+				solver->UpdateVA();
+
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+			std::cout << std::setw(8) << count << " particles, " << std::setw(3) << thread_count << " threads: "
+				<< std::fixed << std::setprecision(3) << ms << " ms/build, " << solver->GetVisibleCount() << " visible\n";
+		}
+	}
+}
+
+// Times the vertex build of a burning scene with the camera zoomed in on the fire, and the tile lists it needs
+static void RunCullingBenchmark(const SolverConfig& base_config) {
+
+	constexpr float zooms[] = { 1.f, 2.f, 4.f, 8.f };
+	constexpr int iterations = 50;
+
+	SolverConfig config = base_config;
+	config.headless = true;
+
+	auto solver = std::make_unique<Solver>(config);
+	RunSolverFrames(*solver, BENCHMARK_FRAMES);
+
+	auto publish_start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < iterations; i++)
+		solver->PublishSnapshot();
+
+	double publish_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - publish_start).count() / iterations;
+	solver->SwapSnapshots();
+
+	std::cout << "Culling benchmark: " << iterations << " builds per zoom, " << solver->GetFrontSnapshot().particle_count << " particles, "
+		<< std::fixed << std::setprecision(3) << publish_ms << " ms/snapshot with tile lists\n";
+
+	for (float zoom : zooms) {
+
+		// Anchored at the bottom center, where the fire burns
+		Camera& camera = solver->GetCamera();
+		camera.Reset();
+		camera.ZoomAt(zoom / camera.GetZoom(), { WINDOW_WIDTH / 2.f, (float)WINDOW_HEIGHT });
+
+		solver->UpdateVA();
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < iterations; i++)
+			solver->UpdateVA();
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+		std::cout << "zoom " << std::setprecision(0) << camera.GetZoom() << ": " << std::setprecision(3) << ms << " ms/build, "
+			<< solver->GetVisibleCount() << " visible" << (solver->IsCulling() ? "" : ", not culled") << '\n';
+	}
+
+	std::cout << std::defaultfloat;
+}
+
+// Walks the governor down every quality level and back up, sending the solver knobs like Simulation::ApplyQuality,
+// and checks that level 0 leaves the adaptive substep range as it was before the first change
+static bool RunGovernorCheck(const SolverConfig& base_config) {
+
+	SolverConfig config = base_config;
+	config.headless = true;
+	config.adaptive_substeps = true;
+	config.max_substeps = std::max(config.max_substeps, SUB_STEPS * 2); // Above the limits of the cheaper levels
+
+	Solver solver(config);
+	QualitySettings applied = QUALITY_LEVELS[0];
+
+	const int before = solver.GetMaxSubSteps();
+
+	auto apply_level = [&](int level) {
+
+		PushSolverQuality(solver, QUALITY_LEVELS[level], applied);
+		solver.UpdateSolver(); // Runs the queued commands
+	};
+
+	for (int level = 1; level < QUALITY_LEVEL_COUNT; level++)
+		apply_level(level);
+
+	const int lowest = solver.GetMaxSubSteps();
+
+	for (int level = QUALITY_LEVEL_COUNT - 2; level >= 0; level--)
+		apply_level(level);
+
+	const int after = solver.GetMaxSubSteps();
+	const bool passed = before == after && before == config.max_substeps;
+
+	std::cout << "Governor check: adaptive substeps up to " << before << " at level 0, " << lowest << " at level " << QUALITY_LEVEL_COUNT - 1
+		<< ", " << after << " back at level 0" << (passed ? "" : " - MISMATCH") << '\n';
+
+	return passed;
+}
+
+// Checks the batched thermal kernel against the original scalar TemperatureBehavior and times both
+static bool RunThermalKernelCheck(uint64_t seed) {
+
+	constexpr int count = 100003; // Not a multiple of the SIMD width, so the scalar tail is covered too
+	constexpr int steps = 64;
+	constexpr float dt = 1.f / 60.f / 8.f;
+	constexpr float tolerance = MAX_TEMPERATURE * 1e-4f;
+
+	ThermalParams params;
+
+	Random rng(seed);
+	std::vector<float> heat(count), reference_temperature(count), temperature(count), reference_buoyancy(count), buoyancy(count);
+
+	for (int i = 0; i < count; i++) {
+
+		// Mostly unheated particles, some partial and some full sources
+		float r = rng.NextFloat();
+		heat[i] = r < 0.7f ? 0.f : r < 0.85f ? rng.NextFloat() : 1.f;
+		temperature[i] = reference_temperature[i] = rng.NextFloat() * MAX_TEMPERATURE;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int step = 0; step < steps; step++) {
+
+		for (int i = 0; i < count; i++) {
+
+			reference_buoyancy[i] = 0.f;
+			ReferenceTemperatureBehavior(reference_temperature[i], heat[i], reference_buoyancy[i], params, dt);
+		}
+	}
+
+	double reference_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+
+	for (int step = 0; step < steps; step++)
+		ThermalKernel(temperature.data(), heat.data(), buoyancy.data(), count, params, dt);
+
+	double kernel_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	float max_temperature_error = 0.f, max_buoyancy_error = 0.f, max_buoyancy = 0.f;
+
+	for (int i = 0; i < count; i++) {
+
+		max_temperature_error = std::max(max_temperature_error, std::abs(temperature[i] - reference_temperature[i]));
+		max_buoyancy_error = std::max(max_buoyancy_error, std::abs(buoyancy[i] - reference_buoyancy[i]));
+		max_buoyancy = std::max(max_buoyancy, std::abs(reference_buoyancy[i]));
+	}
+
+	// Buoyancy grows with T^3, so compare it relative to its largest value
+	bool passed = max_temperature_error <= tolerance && max_buoyancy_error <= max_buoyancy * 1e-4f;
+
+	std::cout << "Thermal kernel check: max temperature error " << max_temperature_error << ", max buoyancy error " << max_buoyancy_error
+		<< " (of " << max_buoyancy << ") - " << (passed ? "passed" : "FAILED") << '\n';
+	std::cout << "  scalar " << std::fixed << std::setprecision(2) << reference_ms * 1e6 / ((double)count * steps) << " ns/particle, "
+		<< "batched " << kernel_ms * 1e6 / ((double)count * steps) << " ns/particle\n";
+
+	return passed;
+}
+
+// Compares the average flame height with fewer thermal updates per frame against the thermal update on every substep
+static void RunThermalRateBenchmark(const SolverConfig& base_config) {
+
+	constexpr int measured_frames = 600;
+	constexpr float flame_temperature = 500.f; // Where the palette turns red, roughly the visible flame
+	constexpr int rates[] = { 8, 4, 2, 1 };
+
+	std::cout << "Thermal rate benchmark: " << BENCHMARK_FRAMES << " warm-up frames, flame height averaged over " << measured_frames << '\n';
+
+	float reference_height = 0.f;
+
+	for (int rate : rates) {
+
+		SolverConfig config = base_config;
+		config.thermal_steps_per_frame = rate;
+
+		auto solver = std::make_unique<Solver>(config);
+		RunSolverFrames(*solver, BENCHMARK_FRAMES);
+
+		double height_sum = 0.0;
+		double ms = 0.0;
+
+		for (int frame = 0; frame < measured_frames; frame++) {
+
+			ms += RunSolverFrames(*solver, 1);
+			height_sum += solver->GetAverageFlameHeight(flame_temperature);
+		}
+
+		float height = (float)(height_sum / measured_frames);
+
+		if (rate == rates[0])
+			reference_height = height;
+
+		float error = reference_height > 0.f ? (height - reference_height) / reference_height * 100.f : 0.f;
+
+		std::cout << "  " << rate << " thermal steps/frame: " << std::fixed << std::setprecision(2) << ms / measured_frames << " ms/frame, "
+			<< "flame height " << std::setprecision(1) << height << " px (" << std::showpos << error << std::noshowpos << "%), "
+			<< solver->GetHotParticleCount() << " hot particles\n";
+	}
+}
+
+// Times the SoftwareRenderer on a burning scene at 1080p and 4K, on 1 and on base_config.render_thread_count threads
+static void RunSoftwareRenderBenchmark(const SolverConfig& base_config) {
+
+	constexpr int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+	constexpr int iterations = 10;
+
+	std::vector<int> thread_counts = { 1 };
+
+	if (base_config.render_thread_count > 1)
+		thread_counts.push_back(base_config.render_thread_count);
+
+	SolverConfig config = base_config;
+	config.headless = true;
+
+	auto solver = std::make_unique<Solver>(config);
+	RunSolverFrames(*solver, BENCHMARK_FRAMES);
+	solver->PublishSnapshot();
+	solver->SwapSnapshots();
+
+	std::cout << "Software render benchmark: " << iterations << " frames per size, " << BENCHMARK_FRAMES << " frames into the fire\n";
+
+	for (const int* size : sizes) {
+
+		for (int thread_count : thread_counts) {
+
+			ThreadPool pool(MakeRenderPoolConfig(config, thread_count));
+			SoftwareRenderer renderer;
+			renderer.Resize(size[0], size[1], config.bloom_levels);
+
+			// First frame sizes the bins, keep it out of the timing
+			renderer.Render(solver->GetFrontSnapshot(), pool);
+
+			auto start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < iterations; i++)
+				renderer.Render(solver->GetFrontSnapshot(), pool);
+
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+			std::cout << std::setw(5) << size[0] << 'x' << std::setw(4) << size[1] << ", " << std::setw(3) << thread_count << " threads: "
+				<< std::fixed << std::setprecision(2) << ms << " ms/frame (" << std::setprecision(1) << 1000.0 / ms << " fps), "
+				<< renderer.GetDrawnCount() << " particles drawn\n";
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+uniform sampler2D current;
+uniform sampler2D previous;
+uniform float weight; // Of the current bloom, 1.0 replaces the history
+
+void main() {
+
+    vec2 uv = gl_TexCoord[0].xy;
+
+    gl_FragColor = mix(texture2D(previous, uv), texture2D(current, uv), weight);
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#include <algorithm>
+#include "SFML/Graphics/View.hpp"
+
+constexpr float CAMERA_MAX_ZOOM = 8.f; // Window pixels per world unit. The least zoom fits the whole world into the window.
+
+// Pan and zoom over the world, in window pixels. The view is kept inside the world;
+// along an axis where the world is smaller than the view it stays centered.
+class Camera {
+
+private:
+	sf::Vector2f window_size;
+	sf::Vector2f world_size;
+	sf::Vector2f center;
+	float zoom = 1.f;
+
+	float GetMinZoom() const {
+
+		return std::min(window_size.x / world_size.x, window_size.y / world_size.y);
+	}
+
+	void Clamp() {
+
+		zoom = std::clamp(zoom, GetMinZoom(), std::max(GetMinZoom(), CAMERA_MAX_ZOOM));
+
+		const sf::Vector2f half = window_size / (2.f * zoom);
+
+		center.x = half.x * 2.f >= world_size.x ? world_size.x / 2.f : std::clamp(center.x, half.x, world_size.x - half.x);
+		center.y = half.y * 2.f >= world_size.y ? world_size.y / 2.f : std::clamp(center.y, half.y, world_size.y - half.y);
+	}
+
+public:
+
+	Camera(sf::Vector2f window, sf::Vector2f world) : window_size(window), world_size(world) {
+
+		Reset();
+	}
+
+	// Shows the whole world
+	void Reset() {
+
+		zoom = GetMinZoom();
+		center = world_size / 2.f;
+	}
+
+	void Pan(sf::Vector2f window_offset) {
+
+		center += window_offset / zoom;
+		Clamp();
+	}
+
+	// Scales the zoom by factor, keeping the world point under window_position in place
+	void ZoomAt(float factor, sf::Vector2f window_position) {
+
+		const sf::Vector2f anchor = ToWorld(window_position);
+
+		zoom *= factor;
+		Clamp();
+
+		center = anchor - (window_position - window_size / 2.f) / zoom;
+		Clamp();
+	}
+
+	sf::Vector2f ToWorld(sf::Vector2f window_position) const {
+
+		return center + (window_position - window_size / 2.f) / zoom;
+	}
+
+	float GetZoom() const { return zoom; }
+
+	// Visible part of the world, may reach past it when the aspect ratios differ
+	sf::FloatRect GetVisibleRect() const {
+
+		const sf::Vector2f size = window_size / zoom;
+
+		return sf::FloatRect(center - size / 2.f, size);
+	}
+
+	sf::View GetView() const { return sf::View(center, window_size / zoom); }
+};
\ No newline at end of file
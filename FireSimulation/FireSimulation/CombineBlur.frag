@@ -1,10 +1,17 @@
 uniform sampler2D originalScene;
 uniform sampler2D blurredBloom;
+uniform vec2 resolution;
+uniform float pixelSize; // 1.0 leaves the image as is
 
 void main() {
 
-    vec4 sceneColor = texture2D(originalScene, gl_TexCoord[0].xy);
-    vec4 bloomColor = texture2D(blurredBloom, gl_TexCoord[0].xy);
+    vec2 uv = gl_TexCoord[0].xy;
+
+    if (pixelSize > 1.0)
+        uv = (floor(uv * resolution / pixelSize) * pixelSize + 0.5) / resolution; // Lock to the first pixel of each block
+
+    vec4 sceneColor = texture2D(originalScene, uv);
+    vec4 bloomColor = texture2D(blurredBloom, uv);
     
     float bloomStrength = 1.05; // Increase bloom intensity
     gl_FragColor = sceneColor + bloomColor * bloomStrength;
@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <cstddef>
+
+// Lock-free ring for exactly one producer thread and one consumer thread.
+// One slot is kept empty to tell a full ring from an empty one.
+template <typename T, size_t Capacity>
+class SpscQueue {
+
+	static_assert(Capacity >= 2, "SpscQueue needs at least two slots");
+
+private:
+	std::array<T, Capacity> buffer;
+
+	// Kept on separate cache lines so the two threads don't fight over them
+	alignas(64) std::atomic<size_t> head{ 0 }; // Next slot to read, owned by the consumer
+	alignas(64) std::atomic<size_t> tail{ 0 }; // Next slot to write, owned by the producer
+
+public:
+
+	// Producer only. Returns false instead of blocking when the ring is full.
+	bool Push(const T& item) {
+
+		const size_t current_tail = tail.load(std::memory_order_relaxed);
+		const size_t next_tail = (current_tail + 1) % Capacity;
+
+		if (next_tail == head.load(std::memory_order_acquire))
+			return false;
+
+		buffer[current_tail] = item;
+		tail.store(next_tail, std::memory_order_release);
+
+		return true;
+	}
+
+	// Consumer only
+	bool Pop(T& item) {
+
+		const size_t current_head = head.load(std::memory_order_relaxed);
+
+		if (current_head == tail.load(std::memory_order_acquire))
+			return false;
+
+		item = buffer[current_head];
+		head.store((current_head + 1) % Capacity, std::memory_order_release);
+
+		return true;
+	}
+};
\ No newline at end of file
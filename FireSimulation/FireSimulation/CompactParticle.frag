@@ -0,0 +1,21 @@
+#version 120
+
+uniform sampler2D palette; // Fire gradient in the top row, smoke in the bottom one
+uniform float paletteSize;
+uniform float filled; // 0 draws everything white, like before the solver first reached its cap
+
+varying float pointRadius;
+varying float temperature;
+varying float smoke;
+
+void main() {
+
+    float dist = length(gl_PointCoord - 0.5) * (pointRadius * 2.0 + 2.0);
+    float coverage = clamp(pointRadius - dist + 0.5, 0.0, 1.0);
+
+    // Same rounding as TemperatureToColor, the texture isn't smooth
+    vec2 uv = vec2((temperature * (paletteSize - 1.0) + 0.5) / paletteSize, smoke * 0.5 + 0.25);
+    vec3 color = filled > 0.5 ? texture2D(palette, uv).rgb : vec3(1.0);
+
+    gl_FragColor = vec4(color, coverage);
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 120
+
+uniform vec2 resolution;
+uniform vec2 viewCenter; // Camera, in world units
+uniform vec2 viewSize;
+uniform float positionScale; // Fixed point units per pixel
+uniform float radiusScale;
+uniform float temperatureScale; // Stored temperature to 0..1
+uniform vec2 diskCenter; // Disk of circle.png in units of the drawn radius, see SPRITE_DISK_X
+uniform float diskRadius;
+
+varying float pointRadius; // Disk radius in window pixels
+varying float temperature;
+varying float smoke;
+
+void main() {
+
+    // Position in gl_Vertex, temperature and radius in the texCoords, the radius negative for smoke
+    vec2 position = gl_Vertex.xy / positionScale;
+    float radius = abs(gl_MultiTexCoord0.y) / radiusScale;
+    vec2 center = position + diskCenter * radius;
+
+    pointRadius = diskRadius * radius * resolution.x / viewSize.x;
+    temperature = gl_MultiTexCoord0.x * temperatureScale;
+    smoke = gl_MultiTexCoord0.y < 0.0 ? 1.0 : 0.0;
+
+    gl_PointSize = pointRadius * 2.0 + 2.0; // A pixel of edge on each side
+    vec2 clip = (center - viewCenter) / viewSize * 2.0;
+    gl_Position = vec4(clip.x, -clip.y, 0.0, 1.0);
+}
\ No newline at end of file
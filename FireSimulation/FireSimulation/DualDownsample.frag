@@ -0,0 +1,27 @@
+uniform sampler2D texture;
+uniform vec2 halfPixel; // Half a texel of the source level
+uniform float threshold; // Luminance a fetch needs to count as light, negative past the first pass
+
+vec4 bright(vec2 uv) {
+
+    vec4 color = texture2D(texture, uv);
+
+    if (dot(color.rgb, vec3(0.2126, 0.7152, 0.0722)) > threshold)
+        return color;
+    else
+        return vec4(0.0);
+}
+
+void main() {
+
+    vec2 uv = gl_TexCoord[0].xy;
+
+    // Center plus the four diagonals, each bilinear fetch averages four source texels
+    vec4 sum = bright(uv) * 4.0;
+    sum += bright(uv - halfPixel);
+    sum += bright(uv + halfPixel);
+    sum += bright(uv + vec2(halfPixel.x, -halfPixel.y));
+    sum += bright(uv - vec2(halfPixel.x, -halfPixel.y));
+
+    gl_FragColor = sum / 8.0;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+uniform sampler2D texture;
+uniform vec2 halfPixel; // Half a texel of the source level
+uniform float gain; // Only the last pass up the chain amplifies
+
+void main() {
+
+    vec2 uv = gl_TexCoord[0].xy;
+
+    // Tent over a ring around the texel, the diagonals weighted double
+    vec4 sum = texture2D(texture, uv + vec2(-halfPixel.x * 2.0, 0.0));
+    sum += texture2D(texture, uv + vec2(-halfPixel.x, halfPixel.y)) * 2.0;
+    sum += texture2D(texture, uv + vec2(0.0, halfPixel.y * 2.0));
+    sum += texture2D(texture, uv + vec2(halfPixel.x, halfPixel.y)) * 2.0;
+    sum += texture2D(texture, uv + vec2(halfPixel.x * 2.0, 0.0));
+    sum += texture2D(texture, uv + vec2(halfPixel.x, -halfPixel.y)) * 2.0;
+    sum += texture2D(texture, uv + vec2(0.0, -halfPixel.y * 2.0));
+    sum += texture2D(texture, uv + vec2(-halfPixel.x, -halfPixel.y)) * 2.0;
+
+    gl_FragColor = sum / 12.0 * gain;
+}
\ No newline at end of file
@@ -0,0 +1,288 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "SFML/Graphics/Image.hpp"
+
+constexpr int EXPORT_RING_SIZE = 8; // Frames the writer may fall behind before Acquire blocks
+
+enum class ExportFormat {
+	Png, // One file per frame, the index is inserted before the extension
+	Y4m, // YUV 4:4:4 stream, BT.601 limited range
+	Rgba // Raw RGBA8 frames back to back, e.g. ffmpeg -f rawvideo -pix_fmt rgba
+};
+
+// Picked from the extension: .png, .y4m, anything else is raw RGBA
+static ExportFormat GetExportFormat(const std::string& path) {
+
+	auto ends_with = [&](const char* extension) {
+
+		size_t length = std::strlen(extension);
+		return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+	};
+
+	if (ends_with(".png")) return ExportFormat::Png;
+	if (ends_with(".y4m")) return ExportFormat::Y4m;
+
+	return ExportFormat::Rgba;
+}
+
+// Writes frames to disk on a background thread. The producer fills preallocated ring slots in place
+// (Acquire, write or memcpy, Commit), so a captured frame costs it one copy and no allocation.
+// When the writer falls EXPORT_RING_SIZE frames behind, Acquire blocks until a slot is free,
+// so a slow disk slows the capture down instead of dropping frames or growing memory.
+class FrameExporter {
+
+private:
+	struct Slot {
+
+		std::vector<uint8_t> pixels;
+		bool bottom_up = false; // Rows from the bottom, as glReadPixels returns them
+	};
+
+	int width = 0;
+	int height = 0;
+	int fps = 60;
+	ExportFormat format = ExportFormat::Rgba;
+	std::string path;
+	std::ofstream stream; // Y4m and Rgba only
+
+	std::vector<Slot> ring;
+	int head = 0; // Next slot the producer fills
+	int tail = 0; // Next slot the writer encodes
+	int queued = 0;
+	bool acquired = false;
+	bool stopping = false;
+
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable slot_filled;
+	std::condition_variable slot_freed;
+
+	// Producer side stats
+	int submitted = 0;
+	int stalls = 0; // Acquires that had to wait for the writer
+	double stall_ms = 0.0;
+	bool failed = false; // Set by the writer, read after it stopped
+
+	std::vector<uint8_t> scratch; // Writer only, flipped rows or YUV planes
+
+	const uint8_t* GetRow(const Slot& slot, int y) const {
+
+		return &slot.pixels[(size_t)(slot.bottom_up ? height - 1 - y : y) * width * 4];
+	}
+
+	std::string GetFramePath(int index) const {
+
+		std::ostringstream name;
+		name << path.substr(0, path.size() - 4) << '_' << std::setw(5) << std::setfill('0') << index << ".png";
+
+		return name.str();
+	}
+
+	bool WriteFrame(const Slot& slot, int index) {
+
+		if (format == ExportFormat::Png) {
+
+			const uint8_t* pixels = slot.pixels.data();
+
+			if (slot.bottom_up) {
+
+				for (int y = 0; y < height; y++)
+					std::memcpy(&scratch[(size_t)y * width * 4], GetRow(slot, y), (size_t)width * 4);
+
+				pixels = scratch.data();
+			}
+
+			sf::Image image;
+			image.create(width, height, pixels);
+
+			return image.saveToFile(GetFramePath(index));
+		}
+
+		if (format == ExportFormat::Rgba) {
+
+			for (int y = 0; y < height; y++)
+				stream.write((const char*)GetRow(slot, y), (std::streamsize)width * 4);
+
+			return (bool)stream;
+		}
+
+		// Y4m, planes written one after the other
+		const size_t plane = (size_t)width * height;
+
+		for (int y = 0; y < height; y++) {
+
+			const uint8_t* row = GetRow(slot, y);
+
+			for (int x = 0; x < width; x++) {
+
+				const float r = row[x * 4], g = row[x * 4 + 1], b = row[x * 4 + 2];
+				const size_t i = (size_t)y * width + x;
+
+				scratch[i] = (uint8_t)(16.5f + (65.481f * r + 128.553f * g + 24.966f * b) / 255.f);
+				scratch[plane + i] = (uint8_t)(128.5f + (-37.797f * r - 74.203f * g + 112.f * b) / 255.f);
+				scratch[plane * 2 + i] = (uint8_t)(128.5f + (112.f * r - 93.786f * g - 18.214f * b) / 255.f);
+			}
+		}
+
+		stream << "FRAME\n";
+		stream.write((const char*)scratch.data(), (std::streamsize)plane * 3);
+
+		return (bool)stream;
+	}
+
+	void WriterLoop() {
+
+		int index = 0;
+
+		while (true) {
+
+			std::unique_lock<std::mutex> lock(mutex);
+			slot_filled.wait(lock, [&] { return queued > 0 || stopping; });
+
+			if (queued == 0) return;
+
+			Slot& slot = ring[tail];
+			lock.unlock();
+
+			// The slot stays out of the producer's reach until it's released below
+			if (!failed && !WriteFrame(slot, index)) {
+
+				std::cerr << "Frame export failed at frame " << index << ", later frames are dropped\n";
+				failed = true;
+			}
+
+			index++;
+
+			lock.lock();
+			tail = (tail + 1) % (int)ring.size();
+			queued--;
+			slot_freed.notify_one();
+		}
+	}
+
+public:
+
+	FrameExporter() = default;
+	FrameExporter(const FrameExporter&) = delete;
+	FrameExporter& operator=(const FrameExporter&) = delete;
+
+	~FrameExporter() {
+
+		Close();
+	}
+
+	bool Open(const std::string& export_path, int frame_width, int frame_height, int frames_per_second) {
+
+		Close();
+
+		path = export_path;
+		width = frame_width;
+		height = frame_height;
+		fps = frames_per_second;
+		format = GetExportFormat(path);
+
+		if (format != ExportFormat::Png) {
+
+			stream.open(path, std::ios::binary);
+
+			if (!stream) {
+
+				std::cerr << "Failed to open " << path << " for export\n";
+				return false;
+			}
+
+			if (format == ExportFormat::Y4m)
+				stream << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1 Ip A1:1 C444\n";
+		}
+
+		ring.assign(EXPORT_RING_SIZE, {});
+
+		for (Slot& slot : ring)
+			slot.pixels.resize((size_t)width * height * 4);
+
+		scratch.resize((size_t)width * height * (format == ExportFormat::Y4m ? 3 : 4));
+
+		head = tail = queued = 0;
+		acquired = stopping = failed = false;
+		submitted = stalls = 0;
+		stall_ms = 0.0;
+
+		writer = std::thread(&FrameExporter::WriterLoop, this);
+
+		return true;
+	}
+
+	bool IsOpen() const { return writer.joinable(); }
+
+	// Returns the next free slot, width * height * 4 bytes, waiting for the writer when all are queued.
+	// Must be followed by Commit before the next Acquire.
+	uint8_t* Acquire() {
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		if (queued == (int)ring.size()) {
+
+			auto start = std::chrono::steady_clock::now();
+			slot_freed.wait(lock, [&] { return queued < (int)ring.size(); });
+
+			stalls++;
+			stall_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		acquired = true;
+
+		return ring[head].pixels.data();
+	}
+
+	// Queues the acquired slot for writing. bottom_up for pixels read back from OpenGL.
+	void Commit(bool bottom_up = false) {
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (!acquired) return;
+
+		ring[head].bottom_up = bottom_up;
+		head = (head + 1) % (int)ring.size();
+		queued++;
+		acquired = false;
+		submitted++;
+
+		slot_filled.notify_one();
+	}
+
+	void Submit(const uint8_t* rgba, bool bottom_up = false) {
+
+		std::memcpy(Acquire(), rgba, (size_t)width * height * 4);
+		Commit(bottom_up);
+	}
+
+	// Writes out everything queued, then stops the writer
+	void Close() {
+
+		if (!IsOpen()) return;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+
+		slot_filled.notify_one();
+		writer.join();
+		stream.close();
+
+		std::cout << "Exported " << submitted << " frames to " << path << ", the capture waited for the writer on " << stalls
+			<< " frames (" << std::fixed << std::setprecision(1) << stall_ms << " ms)" << (failed ? ", with write errors" : "") << '\n' << std::defaultfloat;
+	}
+};
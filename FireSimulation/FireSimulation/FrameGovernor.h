@@ -0,0 +1,176 @@
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "Solver.h"
+
+// Everything the governor may trade for frame time
+struct QualitySettings {
+
+	int sub_steps; // Upper limit, 0 keeps the default count or the whole adaptive range
+	int emit_interval; // Emitters fire every emit_interval frames
+	int bloom_downscale;
+	int bloom_level_drop; // Pyramid levels below the configured depth, at least one level is kept
+	int bloom_interval; // Frames between bloom updates, never below the configured one
+	int particle_cap;
+};
+
+// Ordered from best to cheapest. Each level lowers one or two knobs, cheapest visual loss first;
+// the particle cap is the last resort since removed particles take a while to come back.
+// A lower bloom resolution drops a level with it, so the glow keeps its radius.
+constexpr QualitySettings QUALITY_LEVELS[] = {
+	{ 0, 1, 1, 0, 1, MAX_PARTICLES },
+	{ 0, 1, 1, 0, 2, MAX_PARTICLES },
+	{ 0, 1, 2, 1, 2, MAX_PARTICLES },
+	{ 0, 2, 2, 1, 2, MAX_PARTICLES },
+	{ 6, 2, 2, 1, 4, MAX_PARTICLES },
+	{ 6, 2, 4, 2, 4, MAX_PARTICLES },
+	{ 5, 4, 4, 2, 4, MAX_PARTICLES },
+	{ 4, 4, 4, 2, 4, MAX_PARTICLES },
+	{ 4, 4, 4, 2, 4, MAX_PARTICLES * 3 / 4 },
+	{ 4, 4, 4, 2, 4, MAX_PARTICLES / 2 }
+};
+
+constexpr int QUALITY_LEVEL_COUNT = sizeof(QUALITY_LEVELS) / sizeof(QUALITY_LEVELS[0]);
+
+constexpr float GOVERNOR_SMOOTHING = 0.1f; // Weight of the newest frame in the moving average
+constexpr float GOVERNOR_DOWNGRADE_RATIO = 1.f; // Average above budget * ratio counts as over budget
+constexpr float GOVERNOR_UPGRADE_RATIO = 0.7f; // Average below budget * ratio counts as headroom
+constexpr int GOVERNOR_DOWNGRADE_FRAMES = 15; // Consecutive frames needed before acting
+constexpr int GOVERNOR_UPGRADE_FRAMES = 120;
+constexpr int GOVERNOR_COOLDOWN_FRAMES = 30; // Frames ignored after a change while the new cost settles in
+
+// Queues the solver knobs of settings that differ from applied, the last ones sent, and updates applied.
+// Unchanged knobs aren't resent, so a bloom-only change leaves the substep limit alone.
+static void PushSolverQuality(Solver& solver, const QualitySettings& settings, QualitySettings& applied) {
+
+	SolverCommand command;
+
+	if (settings.sub_steps != applied.sub_steps) {
+
+		command.type = SolverCommandType::SetSubSteps;
+		command.count = settings.sub_steps;
+		solver.PushCommand(command);
+	}
+
+	if (settings.particle_cap != applied.particle_cap) {
+
+		command.type = SolverCommandType::SetParticleCap;
+		command.count = settings.particle_cap;
+		solver.PushCommand(command);
+	}
+
+	applied = settings;
+}
+
+// Measured per frame, in milliseconds
+struct FrameTimings {
+
+	float sim = 0.f; // Solver step and snapshot, on the simulation thread
+	float render = 0.f; // Vertex build and render passes, overlapping the solver step
+	float present = 0.f; // Buffer swap, includes waiting for the GPU
+	float frame = 0.f; // Everything except the frame pacing sleep
+};
+
+// Holds the frame time under a budget by stepping through QUALITY_LEVELS.
+// Drops quality quickly and raises it slowly, so it doesn't oscillate around the budget.
+class FrameGovernor {
+
+private:
+	float budget = 0.f;
+	int level = 0;
+
+	FrameTimings average;
+	bool has_average = false;
+
+	int over_frames = 0;
+	int under_frames = 0;
+	int cooldown = 0;
+	int frame = 0;
+
+	void Log(const char* reason, int from, int to) const {
+
+		const QualitySettings& old_settings = QUALITY_LEVELS[from];
+		const QualitySettings& new_settings = QUALITY_LEVELS[to];
+
+		std::cout << std::fixed << std::setprecision(2)
+			<< "Governor, frame " << frame << ": " << reason << ", " << average.frame << " ms against " << budget << " ms"
+			<< " (sim " << average.sim << ", render " << average.render << ", present " << average.present << ")"
+			<< ", level " << from << " -> " << to << ':';
+
+		auto log_knob = [](const char* name, int old_value, int new_value) {
+
+			if (old_value != new_value)
+				std::cout << ' ' << name << ' ' << old_value << " -> " << new_value;
+		};
+
+		log_knob("substeps", old_settings.sub_steps, new_settings.sub_steps);
+		log_knob("emit interval", old_settings.emit_interval, new_settings.emit_interval);
+		log_knob("bloom downscale", old_settings.bloom_downscale, new_settings.bloom_downscale);
+		log_knob("bloom levels dropped", old_settings.bloom_level_drop, new_settings.bloom_level_drop);
+		log_knob("bloom interval", old_settings.bloom_interval, new_settings.bloom_interval);
+		log_knob("particle cap", old_settings.particle_cap, new_settings.particle_cap);
+
+		std::cout << std::defaultfloat << '\n';
+	}
+
+public:
+
+	// 0 disables the governor, it then stays at the best level
+	void SetBudget(float budget_ms) {
+
+		budget = std::max(0.f, budget_ms);
+	}
+
+	bool IsEnabled() const { return budget > 0.f; }
+
+	const QualitySettings& GetSettings() const { return QUALITY_LEVELS[level]; }
+
+	const FrameTimings& GetAverage() const { return average; }
+
+	// Returns true if the level changed, the caller then applies GetSettings()
+	bool Update(const FrameTimings& timings) {
+
+		frame++;
+
+		if (!IsEnabled()) return false;
+
+		if (!has_average) {
+
+			average = timings;
+			has_average = true;
+		}
+
+		average.sim += (timings.sim - average.sim) * GOVERNOR_SMOOTHING;
+		average.render += (timings.render - average.render) * GOVERNOR_SMOOTHING;
+		average.present += (timings.present - average.present) * GOVERNOR_SMOOTHING;
+		average.frame += (timings.frame - average.frame) * GOVERNOR_SMOOTHING;
+
+		if (cooldown > 0) {
+
+			cooldown--;
+			return false;
+		}
+
+		over_frames = average.frame > budget * GOVERNOR_DOWNGRADE_RATIO ? over_frames + 1 : 0;
+		under_frames = average.frame < budget * GOVERNOR_UPGRADE_RATIO ? under_frames + 1 : 0;
+
+		int new_level = level;
+
+		if (over_frames >= GOVERNOR_DOWNGRADE_FRAMES && level < QUALITY_LEVEL_COUNT - 1)
+			new_level = level + 1;
+		else if (under_frames >= GOVERNOR_UPGRADE_FRAMES && level > 0)
+			new_level = level - 1;
+
+		if (new_level == level) return false;
+
+		Log(new_level > level ? "over budget" : "headroom", level, new_level);
+
+		level = new_level;
+		over_frames = 0;
+		under_frames = 0;
+		cooldown = GOVERNOR_COOLDOWN_FRAMES;
+
+		return true;
+	}
+};
\ No newline at end of file
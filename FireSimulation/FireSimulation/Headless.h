@@ -0,0 +1,91 @@
+#pragma once
+#include "Simulation.h"
+#include "SoftwareRenderer.h"
+#include "FrameExporter.h"
+#include <chrono>
+#include <string>
+
+struct HeadlessConfig {
+
+	int frames = 0; // 0 runs the windowed simulation instead
+	int width = 1920;
+	int height = 1080;
+	std::string output_path; // The last frame is saved here, empty = not saved
+	std::string capture_path; // Every frame is exported here, see FrameExporter. Empty = no capture.
+};
+
+static ThreadPoolConfig MakeRenderPoolConfig(const SolverConfig& config, int thread_count) {
+
+	ThreadPoolConfig pool_config;
+	pool_config.thread_count = std::max(1, thread_count);
+	pool_config.affinity_mask = config.render_affinity_mask;
+	pool_config.spin_count = config.spin_count;
+
+	return pool_config;
+}
+
+// Runs the simulation without a window or OpenGL context, every frame is drawn by the SoftwareRenderer
+static bool RunHeadless(SolverConfig config, const HeadlessConfig& headless_config) {
+
+	using Clock = std::chrono::steady_clock;
+
+	config.headless = true;
+
+	auto solver = std::make_unique<Solver>(config);
+	ThreadPool pool(MakeRenderPoolConfig(config, config.render_thread_count));
+
+	SoftwareRenderer renderer;
+	renderer.Resize(headless_config.width, headless_config.height, config.bloom_levels);
+
+	FrameExporter exporter;
+
+	if (!headless_config.capture_path.empty() && !exporter.Open(headless_config.capture_path, renderer.GetWidth(), renderer.GetHeight(), FRAMERATE))
+		return false;
+
+	double sim_ms = 0.0, render_ms = 0.0, capture_ms = 0.0;
+
+	for (int frame = 0; frame < headless_config.frames; frame++) {
+
+		Clock::time_point sim_start = Clock::now();
+
+		if ((int)solver->GetParticles().size() < solver->GetParticleCap())
+			SpawnEmitters(*solver);
+
+		solver->UpdateSolver();
+		solver->PublishSnapshot();
+		solver->SwapSnapshots();
+
+		Clock::time_point render_start = Clock::now();
+		renderer.Render(solver->GetFrontSnapshot(), pool);
+		Clock::time_point render_end = Clock::now();
+
+		if (exporter.IsOpen())
+			exporter.Submit(renderer.GetPixels().data());
+
+		sim_ms += std::chrono::duration<double, std::milli>(render_start - sim_start).count();
+		render_ms += std::chrono::duration<double, std::milli>(render_end - render_start).count();
+		capture_ms += std::chrono::duration<double, std::milli>(Clock::now() - render_end).count();
+	}
+
+	exporter.Close();
+
+	const int frames = std::max(1, headless_config.frames);
+
+	std::cout << "Headless: " << headless_config.frames << " frames at " << renderer.GetWidth() << 'x' << renderer.GetHeight()
+		<< " on " << pool.GetThreadCount() << " render threads, " << std::fixed << std::setprecision(2)
+		<< sim_ms / frames << " ms/frame solver, " << render_ms / frames << " ms/frame render, " << capture_ms / frames << " ms/frame capture, "
+		<< renderer.GetDrawnCount() << " particles drawn in the last frame\n" << std::defaultfloat;
+
+	if (headless_config.output_path.empty()) return true;
+
+	sf::Image image;
+	image.create(renderer.GetWidth(), renderer.GetHeight(), renderer.GetPixels().data());
+
+	if (!image.saveToFile(headless_config.output_path)) {
+
+		std::cerr << "Failed to save " << headless_config.output_path << '\n';
+		return false;
+	}
+
+	return true;
+}
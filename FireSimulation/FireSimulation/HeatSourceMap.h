@@ -0,0 +1,144 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include "SFML/Graphics/Image.hpp"
+
+// Heating intensity per grid cell, 0 = no heating, 1 = full heating rate.
+// Particles look up the cell under their center, so any number of sources costs one read per particle.
+class HeatSourceMap {
+
+private:
+	int width = 0;
+	int height = 0;
+	float cell_size = 1.f;
+
+	std::vector<float> intensity;
+
+public:
+
+	void Resize(int grid_width, int grid_height, float grid_cell_size) {
+
+		width = grid_width;
+		height = grid_height;
+		cell_size = grid_cell_size;
+
+		intensity.assign(width * height, 0.f);
+	}
+
+	void Clear() {
+
+		std::fill(intensity.begin(), intensity.end(), 0.f);
+	}
+
+	float Lookup(sf::Vector2f position) const {
+
+		int x = std::clamp((int)(position.x / cell_size), 0, width - 1);
+		int y = std::clamp((int)(position.y / cell_size), 0, height - 1);
+
+		return intensity[y * width + x];
+	}
+
+	// Rectangle in pixels. Overlapping sources keep the stronger one.
+	void FillRect(float left, float top, float rect_width, float rect_height, float value) {
+
+		int min_x = std::max(0, (int)(left / cell_size)), max_x = std::min(width - 1, (int)((left + rect_width) / cell_size));
+		int min_y = std::max(0, (int)(top / cell_size)), max_y = std::min(height - 1, (int)((top + rect_height) / cell_size));
+
+		for (int y = min_y; y <= max_y; y++)
+			for (int x = min_x; x <= max_x; x++)
+				intensity[y * width + x] = std::max(intensity[y * width + x], value);
+	}
+
+	void FillCircle(sf::Vector2f center, float radius, float value) {
+
+		int min_x = std::max(0, (int)((center.x - radius) / cell_size)), max_x = std::min(width - 1, (int)((center.x + radius) / cell_size));
+		int min_y = std::max(0, (int)((center.y - radius) / cell_size)), max_y = std::min(height - 1, (int)((center.y + radius) / cell_size));
+
+		for (int y = min_y; y <= max_y; y++) {
+
+			for (int x = min_x; x <= max_x; x++) {
+
+				float dx = (x + 0.5f) * cell_size - center.x, dy = (y + 0.5f) * cell_size - center.y;
+
+				if (dx * dx + dy * dy <= radius * radius)
+					intensity[y * width + x] = std::max(intensity[y * width + x], value);
+			}
+		}
+	}
+
+	// Stretches the image over the whole map, the red channel is the intensity
+	void PaintImage(const sf::Image& image) {
+
+		sf::Vector2u size = image.getSize();
+		if (size.x == 0 || size.y == 0) return;
+
+		for (int y = 0; y < height; y++) {
+
+			for (int x = 0; x < width; x++) {
+
+				unsigned int image_x = (unsigned int)((x + 0.5f) * size.x / width);
+				unsigned int image_y = (unsigned int)((y + 0.5f) * size.y / height);
+
+				float value = image.getPixel(image_x, image_y).r / 255.f;
+				intensity[y * width + x] = std::max(intensity[y * width + x], value);
+			}
+		}
+	}
+
+	// Text map, one source per line, coordinates in pixels:
+	//   rect <left> <top> <width> <height> <intensity>
+	//   circle <x> <y> <radius> <intensity>
+	//   image <path>
+	// Lines starting with # are ignored. Sources are added to what's already in the map.
+	bool LoadFromFile(const std::string& path) {
+
+		std::ifstream file(path);
+
+		if (!file) {
+
+			std::cerr << "Failed to load heat map " << path << '\n';
+			return false;
+		}
+
+		std::string line;
+
+		while (std::getline(file, line)) {
+
+			std::istringstream stream(line);
+			std::string kind;
+
+			if (!(stream >> kind) || kind[0] == '#') continue;
+
+			if (kind == "rect") {
+
+				float left, top, rect_width, rect_height, value;
+				if (stream >> left >> top >> rect_width >> rect_height >> value)
+					FillRect(left, top, rect_width, rect_height, value);
+			}
+			else if (kind == "circle") {
+
+				float x, y, radius, value;
+				if (stream >> x >> y >> radius >> value)
+					FillCircle({ x, y }, radius, value);
+			}
+			else if (kind == "image") {
+
+				std::string image_path;
+				sf::Image image;
+
+				if (stream >> image_path && image.loadFromFile(image_path))
+					PaintImage(image);
+			}
+			else {
+
+				std::cerr << "Unknown heat map entry: " << kind << '\n';
+			}
+		}
+
+		return true;
+	}
+};
\ No newline at end of file
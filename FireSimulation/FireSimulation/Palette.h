@@ -0,0 +1,69 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <algorithm>
+#include "Particle.h"
+
+// Temperature to color gradient, evaluated at compile time and only looked up at render time
+
+struct PaletteColor {
+
+	uint8_t r, g, b;
+};
+
+constexpr int PALETTE_SIZE = 1024;
+
+constexpr float PALETTE_TEMP_DIFF = 300.f;
+constexpr float PALETTE_HEAT_TEMP = 500.f;
+constexpr float PALETTE_INTERMEDIATE_TEMP = PALETTE_HEAT_TEMP + PALETTE_TEMP_DIFF;
+constexpr float PALETTE_INTERMEDIATE_TEMP2 = PALETTE_INTERMEDIATE_TEMP + PALETTE_TEMP_DIFF;
+
+constexpr PaletteColor PALETTE_BLACK = { 0, 0, 0 };
+constexpr PaletteColor PALETTE_HEAT = { 255, 0, 0 };
+constexpr PaletteColor PALETTE_INTERMEDIATE = { 255, 147, 5 };
+constexpr PaletteColor PALETTE_INTERMEDIATE2 = { 255, 206, 92 };
+constexpr PaletteColor PALETTE_WHITE = { 255, 255, 255 };
+
+constexpr PaletteColor LerpPaletteColor(PaletteColor from, PaletteColor to, float t) {
+
+	return {
+		(uint8_t)(from.r + (to.r - from.r) * t),
+		(uint8_t)(from.g + (to.g - from.g) * t),
+		(uint8_t)(from.b + (to.b - from.b) * t)
+	};
+}
+
+// Black -> red -> orange -> yellow -> white
+constexpr PaletteColor EvaluatePalette(float temperature) {
+
+	if (temperature < PALETTE_HEAT_TEMP)
+		return LerpPaletteColor(PALETTE_BLACK, PALETTE_HEAT, temperature / PALETTE_HEAT_TEMP);
+	else if (temperature < PALETTE_INTERMEDIATE_TEMP)
+		return LerpPaletteColor(PALETTE_HEAT, PALETTE_INTERMEDIATE, (temperature - PALETTE_HEAT_TEMP) / PALETTE_TEMP_DIFF);
+	else if (temperature < PALETTE_INTERMEDIATE_TEMP2)
+		return LerpPaletteColor(PALETTE_INTERMEDIATE, PALETTE_INTERMEDIATE2, (temperature - PALETTE_INTERMEDIATE_TEMP) / PALETTE_TEMP_DIFF);
+	else
+		return LerpPaletteColor(PALETTE_INTERMEDIATE2, PALETTE_WHITE, (temperature - PALETTE_INTERMEDIATE_TEMP2) / (MAX_TEMPERATURE - PALETTE_INTERMEDIATE_TEMP2));
+}
+
+constexpr std::array<PaletteColor, PALETTE_SIZE> BuildPalette() {
+
+	std::array<PaletteColor, PALETTE_SIZE> palette{};
+
+	for (int i = 0; i < PALETTE_SIZE; i++)
+		palette[i] = EvaluatePalette(MAX_TEMPERATURE * (float)i / (float)(PALETTE_SIZE - 1));
+
+	return palette;
+}
+
+constexpr std::array<PaletteColor, PALETTE_SIZE> PALETTE = BuildPalette();
+
+inline sf::Color TemperatureToColor(float temperature) {
+
+	int index = (int)(temperature * ((PALETTE_SIZE - 1) / MAX_TEMPERATURE) + 0.5f);
+	index = std::clamp(index, 0, PALETTE_SIZE - 1);
+
+	const PaletteColor& color = PALETTE[index];
+
+	return sf::Color(color.r, color.g, color.b);
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+uniform vec2 center; // Of the disk, in sprite units: the triangle spans -1 to 1 on both axes
+uniform float radius;
+
+void main() {
+
+    // Without a texture the texCoords arrive unscaled, 0 to 400 like the circle.png mapping
+    vec2 local = gl_TexCoord[0].xy / 200.0 - 1.0;
+    float dist = length(local - center);
+
+    // One pixel wide edge, like the antialiased edge of the texture
+    float edge = fwidth(dist);
+    float coverage = clamp((radius - dist) / edge + 0.5, 0.0, 1.0);
+
+    gl_FragColor = vec4(gl_Color.rgb, gl_Color.a * coverage);
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "SFML/OpenGL.hpp"
+#include "SFML/Window/Context.hpp"
+
+// Pixel buffer objects, past the OpenGL 1.1 headers shipped on Windows
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+// Reads the framebuffer back through two pixel buffer objects. glReadPixels into a bound buffer returns
+// right away, the copy finishes on the GPU, and the buffer is mapped a frame later when it's long done.
+// Frames therefore come out one frame late, and the last one has to be collected with Finish.
+// Falls back to a synchronous glReadPixels when the buffer functions can't be loaded.
+class PixelReadback {
+
+private:
+	using GenBuffers = void (APIENTRY*)(GLsizei, GLuint*);
+	using DeleteBuffers = void (APIENTRY*)(GLsizei, const GLuint*);
+	using BindBuffer = void (APIENTRY*)(GLenum, GLuint);
+	using BufferData = void (APIENTRY*)(GLenum, std::ptrdiff_t, const void*, GLenum);
+	using MapBuffer = void* (APIENTRY*)(GLenum, GLenum);
+	using UnmapBuffer = GLboolean (APIENTRY*)(GLenum);
+
+	GenBuffers gen_buffers = nullptr;
+	DeleteBuffers delete_buffers = nullptr;
+	BindBuffer bind_buffer = nullptr;
+	BufferData buffer_data = nullptr;
+	MapBuffer map_buffer = nullptr;
+	UnmapBuffer unmap_buffer = nullptr;
+
+	int width = 0;
+	int height = 0;
+	GLuint buffers[2] = {};
+	int index = 0; // Buffer the next frame is read into
+	bool pending = false; // buffers[1 - index] holds a frame that wasn't collected yet
+
+	// Copies the pending frame to pixels, width * height * 4 bytes
+	bool CollectPending(uint8_t* pixels) {
+
+		if (!pending) return false;
+
+		bind_buffer(GL_PIXEL_PACK_BUFFER, buffers[1 - index]);
+		const void* mapped = map_buffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+
+		if (mapped) {
+
+			std::memcpy(pixels, mapped, (size_t)width * height * 4);
+			unmap_buffer(GL_PIXEL_PACK_BUFFER);
+		}
+
+		bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+		pending = false;
+
+		return mapped != nullptr;
+	}
+
+public:
+
+	PixelReadback() = default;
+	PixelReadback(const PixelReadback&) = delete;
+	PixelReadback& operator=(const PixelReadback&) = delete;
+
+	// Must run while the context is still alive, the destructor can't rely on that
+	void Release() {
+
+		if (IsAsync() && buffers[0] != 0)
+			delete_buffers(2, buffers);
+
+		buffers[0] = buffers[1] = 0;
+		pending = false;
+	}
+
+	// Needs the window's context to be active. Returns false when it falls back to synchronous reads.
+	bool Init(int read_width, int read_height) {
+
+		width = read_width;
+		height = read_height;
+
+		gen_buffers = (GenBuffers)sf::Context::getFunction("glGenBuffers");
+		delete_buffers = (DeleteBuffers)sf::Context::getFunction("glDeleteBuffers");
+		bind_buffer = (BindBuffer)sf::Context::getFunction("glBindBuffer");
+		buffer_data = (BufferData)sf::Context::getFunction("glBufferData");
+		map_buffer = (MapBuffer)sf::Context::getFunction("glMapBuffer");
+		unmap_buffer = (UnmapBuffer)sf::Context::getFunction("glUnmapBuffer");
+
+		if (!IsAsync()) return false;
+
+		gen_buffers(2, buffers);
+
+		for (GLuint buffer : buffers) {
+
+			bind_buffer(GL_PIXEL_PACK_BUFFER, buffer);
+			buffer_data(GL_PIXEL_PACK_BUFFER, (std::ptrdiff_t)width * height * 4, nullptr, GL_STREAM_READ);
+		}
+
+		bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		return true;
+	}
+
+	bool IsAsync() const {
+
+		return gen_buffers && delete_buffers && bind_buffer && buffer_data && map_buffer && unmap_buffer;
+	}
+
+	// Starts reading the current back buffer. acquire returns where a frame goes, width * height * 4 bytes;
+	// returns true once the previous frame (or, synchronously, this one) was copied there. Rows are bottom up.
+	template <typename AcquireFunction>
+	bool Read(AcquireFunction acquire) {
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+		if (!IsAsync()) {
+
+			glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, acquire());
+			return true;
+		}
+
+		const bool collected = pending && CollectPending(acquire());
+
+		bind_buffer(GL_PIXEL_PACK_BUFFER, buffers[index]);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		index = 1 - index;
+		pending = true;
+
+		return collected;
+	}
+
+	// Collects the last frame still in flight, while the context is alive
+	template <typename AcquireFunction>
+	bool Finish(AcquireFunction acquire) {
+
+		return pending && CollectPending(acquire());
+	}
+};
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+
+// Small seedable PRNG (PCG32) so a run can be replayed from its seed
+class Random {
+
+private:
+	uint64_t state = 0;
+	uint64_t increment = 1;
+
+public:
+
+	Random(uint64_t seed = 0) {
+
+		Seed(seed);
+	}
+
+	void Seed(uint64_t seed) {
+
+		state = 0;
+		increment = (seed << 1u) | 1u;
+		NextUInt();
+		state += seed;
+		NextUInt();
+	}
+
+	uint32_t NextUInt() {
+
+		uint64_t old_state = state;
+		state = old_state * 6364136223846793005ULL + increment;
+
+		uint32_t xorshifted = (uint32_t)(((old_state >> 18u) ^ old_state) >> 27u);
+		uint32_t rotation = (uint32_t)(old_state >> 59u);
+
+		return (xorshifted >> rotation) | (xorshifted << ((~rotation + 1u) & 31u));
+	}
+
+	// Returns a value in [0, max)
+	int NextInt(int max) {
+
+		if (max <= 0) return 0;
+
+		return (int)(NextUInt() % (uint32_t)max);
+	}
+
+	// Returns a value in [0, 1)
+	float NextFloat() {
+
+		return (float)(NextUInt() >> 8) * (1.f / 16777216.f);
+	}
+};
\ No newline at end of file
@@ -1,33 +1,256 @@
 #include "Simulation.h"
+#include "SFML/OpenGL.hpp"
 
-Simulation::Simulation() {
+Simulation::Simulation(const SolverConfig& solver_config, const SimulationConfig& simulation_config)
+	: solver(solver_config),
+	thermal_mode(solver_config.thermal_mode)
+{
 
 	window = new sf::RenderWindow(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Fire Simulation", sf::Style::Titlebar | sf::Style::Close);
-	window->setFramerateLimit(FRAMERATE);
+
+	governor.SetBudget(simulation_config.frame_budget_ms);
+
+	// The governor has to see the real frame cost, so it paces the frames itself instead of sleeping inside display()
+	if (!governor.IsEnabled())
+		window->setFramerateLimit(FRAMERATE);
+
+	if (!simulation_config.capture_path.empty() && exporter.Open(simulation_config.capture_path, WINDOW_WIDTH, WINDOW_HEIGHT, FRAMERATE)) {
+
+		if (!readback.Init(WINDOW_WIDTH, WINDOW_HEIGHT))
+			std::cout << "Pixel buffers unavailable, captured frames are read back synchronously\n";
+	}
+
+	sim_thread = std::thread(&Simulation::SimThreadLoop, this);
 }
 
 Simulation::~Simulation() {
 
+	{
+		std::lock_guard<std::mutex> lock(sim_mutex);
+		stopping = true;
+	}
+
+	sim_cv.notify_all();
+	sim_thread.join();
+
+	if (captured_frames > 0) {
+
+		std::cout << "Capture: " << std::fixed << std::setprecision(2) << capture_ms / captured_frames << " ms/frame readback on the main thread"
+			<< (readback.IsAsync() ? ", through pixel buffers" : ", synchronous") << '\n' << std::defaultfloat;
+	}
+
 	delete window;
 }
 
+void Simulation::SimThreadLoop() {
+
+	solver.ApplySimThreadSettings();
+
+	while (true) {
+
+		{
+			std::unique_lock<std::mutex> lock(sim_mutex);
+			sim_cv.wait(lock, [&] { return step_pending || stopping; });
+
+			if (stopping) return;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		solver.UpdateSolver();
+		solver.PublishSnapshot();
+
+		{
+			std::lock_guard<std::mutex> lock(sim_mutex);
+			sim_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+			step_pending = false;
+		}
+
+		sim_cv.notify_all();
+	}
+}
+
+// Starts the readback of the finished back buffer and copies the previous frame, read back by now, into a free
+// export slot. That copy is the only one on this thread; the GPU isn't waited for unless pixel buffers are unavailable.
+void Simulation::CaptureFrame() {
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (readback.Read([&] { return exporter.Acquire(); }))
+		exporter.Commit(true);
+
+	capture_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	captured_frames++;
+}
+
+void Simulation::BeginStep() {
+
+	{
+		std::lock_guard<std::mutex> lock(sim_mutex);
+		step_pending = true;
+	}
+
+	sim_cv.notify_all();
+}
+
+void Simulation::EndStep() {
+
+	std::unique_lock<std::mutex> lock(sim_mutex);
+	sim_cv.wait(lock, [&] { return !step_pending; });
+}
+
+// Stats of the displayed frame, so they match what's on screen
+void Simulation::ShowStats() {
+
+	const RenderSnapshot& snapshot = solver.GetFrontSnapshot();
+	const SolverStats& stats = snapshot.stats;
+
+	std::ostringstream title;
+	title << "Fire Simulation - " << stats.sub_steps << " substeps, " << stats.thermal_steps << " thermal"
+		<< ", max move " << std::fixed << std::setprecision(2) << stats.max_displacement
+		<< ", mean overlap " << stats.mean_penetration
+		<< ", " << stats.hot_particles << " hot"
+		<< ", vertices " << solver.GetUploadBytes() / 1024 << " KB/frame" << (solver.IsUsingVertexBuffer() ? " streamed" : " resubmitted");
+
+	if (solver.IsCulling())
+		title << ", zoom " << std::setprecision(1) << solver.GetCamera().GetZoom() << ", drawing " << solver.GetVisibleCount() << '/' << snapshot.particle_count;
+
+	if (solver.GetConfig().spatial_lod)
+		title << ", tiles " << stats.full_rate_tiles << '/' << stats.half_rate_tiles << '/' << stats.quarter_rate_tiles;
+
+	if (solver.GetConfig().species) {
+
+		const auto& begin = snapshot.species_begin;
+
+		title << ", fuel " << begin[1] - begin[0] << ", flame " << begin[2] - begin[1]
+			<< ", smoke " << begin[3] - begin[2] << ", inert " << snapshot.particle_count - begin[3];
+	}
+
+	window->setTitle(title.str());
+}
+
+// Render knobs apply directly, solver knobs go through the command queue
+void Simulation::ApplyQuality(const QualitySettings& settings) {
+
+	const SolverConfig& config = solver.GetConfig();
+	solver.SetBloomQuality(settings.bloom_downscale, config.bloom_levels - settings.bloom_level_drop, std::max(config.bloom_interval, settings.bloom_interval));
+	emit_interval = settings.emit_interval;
+
+	PushSolverQuality(solver, settings, applied_quality);
+}
+
 void Simulation::HandleEvent(sf::Event& e) {
 
 	if (e.type == __noop) {
+
+		// The last frame is still in flight, collect it while the context exists
+		if (exporter.IsOpen() && readback.Finish([&] { return exporter.Acquire(); }))
+			exporter.Commit(true);
+
+		readback.Release();
 		window->close();
 	}
 
 	if (e.type == e.KeyPressed) {
 
+		// Render-side only, so it doesn't go through the solver's command queue
 		if (e.key.code == sf::Keyboard::P)
 			solver.SetPixelated();
+
+		if (e.key.code == sf::Keyboard::Up || e.key.code == sf::Keyboard::Down) {
+
+			gravity += e.key.code == sf::Keyboard::Up ? GRAVITY_STEP : -GRAVITY_STEP;
+
+			SolverCommand command;
+			command.type = SolverCommandType::SetGravity;
+			command.amount = gravity;
+			solver.PushCommand(command);
+		}
+
+		if (e.key.code == sf::Keyboard::T) {
+
+			thermal_mode = (ThermalMode)(((int)thermal_mode + 1) % 3);
+
+			SolverCommand command;
+			command.type = SolverCommandType::SetThermalMode;
+			command.count = (int)thermal_mode;
+			solver.PushCommand(command);
+		}
+
+		if (e.key.code == sf::Keyboard::C) {
+
+			SolverCommand command;
+			command.type = SolverCommandType::ResetHeatSources;
+			solver.PushCommand(command);
+		}
+
+		// Camera, render side only like the pixelation
+		Camera& camera = solver.GetCamera();
+
+		if (e.key.code == sf::Keyboard::W) camera.Pan({ 0.f, -CAMERA_PAN_STEP });
+		if (e.key.code == sf::Keyboard::S) camera.Pan({ 0.f, CAMERA_PAN_STEP });
+		if (e.key.code == sf::Keyboard::A) camera.Pan({ -CAMERA_PAN_STEP, 0.f });
+		if (e.key.code == sf::Keyboard::D) camera.Pan({ CAMERA_PAN_STEP, 0.f });
+		if (e.key.code == sf::Keyboard::R) camera.Reset();
+	}
+
+	if (e.type == e.MouseWheelScrolled) {
+
+		const float factor = std::pow(CAMERA_ZOOM_STEP, e.mouseWheelScroll.delta);
+		solver.GetCamera().ZoomAt(factor, { (float)e.mouseWheelScroll.x, (float)e.mouseWheelScroll.y });
+	}
+
+	if (e.type == e.MouseButtonPressed && e.mouseButton.button == sf::Mouse::Right) {
+
+		SolverCommand command;
+		command.type = SolverCommandType::SpawnBurst;
+		command.position = solver.GetCamera().ToWorld({ (float)e.mouseButton.x, (float)e.mouseButton.y });
+		command.radius = HEAT_BRUSH_RADIUS;
+		command.count = SPAWN_BURST_COUNT;
+		solver.PushCommand(command);
+	}
+}
+
+void Simulation::HandleMouse() {
+
+	if (!window->hasFocus())
+		return;
+
+	sf::Vector2i mouse_pixel = sf::Mouse::getPosition(*window);
+	sf::Vector2f mouse_position = solver.GetCamera().ToWorld({ (float)mouse_pixel.x, (float)mouse_pixel.y });
+
+	if (sf::Mouse::isButtonPressed(sf::Mouse::Left)) {
+
+		SolverCommand command;
+		command.type = SolverCommandType::HeatBrush;
+		command.position = mouse_position;
+		command.radius = HEAT_BRUSH_RADIUS;
+		command.amount = HEAT_BRUSH_AMOUNT;
+		solver.PushCommand(command);
+	}
+
+	// Paints a permanent burner into the heat source map
+	if (sf::Mouse::isButtonPressed(sf::Mouse::Middle)) {
+
+		SolverCommand command;
+		command.type = SolverCommandType::PaintHeatSource;
+		command.position = mouse_position;
+		command.radius = HEAT_SOURCE_RADIUS;
+		command.amount = 1.f;
+		solver.PushCommand(command);
 	}
 }
 
 void Simulation::Update() {
 
+	using Clock = std::chrono::steady_clock;
+	const Clock::duration frame_period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / FRAMERATE));
+	Clock::time_point next_frame = Clock::now();
+
 	while (window->isOpen()) {
 
+		Clock::time_point frame_start = Clock::now();
+
 		sf::Event e;
 
 		while (window->pollEvent(e)) {
@@ -35,27 +258,52 @@ void Simulation::Update() {
 			HandleEvent(e);
 		}
 
-		if ((int)solver.GetParticles().size() < MAX_PARTICLES) {
-			solver.Spawn({ WINDOW_WIDTH / 2 - 200, RENDER_RADIUS });
-			solver.Spawn({ WINDOW_WIDTH / 2 - 150, RENDER_RADIUS });
-			solver.Spawn({ WINDOW_WIDTH / 2 - 100, RENDER_RADIUS });
-			solver.Spawn({ WINDOW_WIDTH / 2 - 50, RENDER_RADIUS });
-			solver.Spawn({ WINDOW_WIDTH / 2 - 15, RENDER_RADIUS });
-			solver.Spawn({ WINDOW_WIDTH / 2, RENDER_RADIUS });
-			solver.Spawn({ WINDOW_WIDTH / 2 + 15, RENDER_RADIUS });
-			solver.Spawn({ WINDOW_WIDTH / 2 + 50, RENDER_RADIUS });
-			solver.Spawn({ WINDOW_WIDTH / 2 + 100, RENDER_RADIUS });
-			solver.Spawn({ WINDOW_WIDTH / 2 + 150, RENDER_RADIUS });
-			solver.Spawn({ WINDOW_WIDTH / 2 + 200, RENDER_RADIUS });
+		HandleMouse();
 
-			std::cout << "Number of particles: " << solver.GetParticles().size() << '/' << MAX_PARTICLES << '\n';
-		}
+		if (solver.GetParticleCount() < applied_quality.particle_cap && frame % emit_interval == 0) {
+			SpawnEmitters(solver);
 
-		solver.UpdateSolver();
+			std::cout << "Number of particles: " << solver.GetParticleCount() << '/' << applied_quality.particle_cap << '\n';
+		}
 
+		// The solver only touches the back snapshot, so frame N renders while N + 1 is simulated
+		BeginStep();
 
+		Clock::time_point render_start = Clock::now();
 		solver.Render(window);
+
+		if (exporter.IsOpen())
+			CaptureFrame();
+
+		Clock::time_point present_start = Clock::now();
 		window->display();
+		Clock::time_point present_end = Clock::now();
+
+		EndStep();
+
+		// Displayed state lags the simulation by at most one frame
+		solver.SwapSnapshots();
 
+		if (++frame % STATS_INTERVAL == 0)
+			ShowStats();
+
+		if (governor.IsEnabled()) {
+
+			timings.sim = sim_ms;
+			timings.render = std::chrono::duration<float, std::milli>(present_start - render_start).count();
+			timings.present = std::chrono::duration<float, std::milli>(present_end - present_start).count();
+			timings.frame = std::chrono::duration<float, std::milli>(Clock::now() - frame_start).count();
+
+			if (governor.Update(timings))
+				ApplyQuality(governor.GetSettings());
+
+			// Frame pacing, skipped when behind so a slow frame isn't followed by a burst of fast ones
+			next_frame += frame_period;
+
+			if (next_frame > Clock::now())
+				std::this_thread::sleep_until(next_frame);
+			else
+				next_frame = Clock::now();
+		}
 	}
 }
\ No newline at end of file
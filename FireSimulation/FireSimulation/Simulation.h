@@ -1,19 +1,91 @@
 #pragma once
 #include "Solver.h"
+#include "FrameGovernor.h"
+#include "FrameExporter.h"
+#include "PixelReadback.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
 
 constexpr unsigned int FRAMERATE = 60;
 
+// Horizontal emitter offsets from the world center, one particle per emitter per frame
+constexpr float EMITTER_OFFSETS[] = { -200.f, -150.f, -100.f, -50.f, -15.f, 0.f, 15.f, 50.f, 100.f, 150.f, 200.f };
+
+constexpr float HEAT_BRUSH_RADIUS = 30.f;
+constexpr float HEAT_BRUSH_AMOUNT = 40.f; // Degrees per frame while the button is held
+constexpr float HEAT_SOURCE_RADIUS = 20.f;
+constexpr int SPAWN_BURST_COUNT = 50;
+constexpr float GRAVITY_STEP = 250.f;
+constexpr float CAMERA_PAN_STEP = 40.f; // Window pixels per key press
+constexpr float CAMERA_ZOOM_STEP = 1.25f; // Per mouse wheel notch
+constexpr int STATS_INTERVAL = 30; // Frames between window title updates
+
+// Queued, so it can be called from the input thread while the solver is running
+static void SpawnEmitters(Solver& solver) {
+
+	for (float offset : EMITTER_OFFSETS) {
+
+		SolverCommand command;
+		command.type = SolverCommandType::Spawn;
+		command.position = { WORLD_WIDTH / 2 + offset, RENDER_RADIUS };
+
+		solver.PushCommand(command);
+	}
+}
+
+struct SimulationConfig {
+
+	float frame_budget_ms = 0.f; // Target frame time for the FrameGovernor, 0 keeps full quality
+	std::string capture_path; // Every displayed frame is exported here, see FrameExporter. Empty = no capture.
+};
+
 class Simulation {
 
 private:
 	Solver solver;
 	sf::RenderWindow* window;
 
+	// The solver steps frame N + 1 on its own thread while frame N is rendered
+	std::thread sim_thread;
+	std::mutex sim_mutex;
+	std::condition_variable sim_cv;
+	bool step_pending = false;
+	bool stopping = false;
+
+	float gravity = GRAVITY; // Last values sent to the solver
+	ThermalMode thermal_mode;
+
+	int frame = 0;
+
+	FrameGovernor governor;
+	FrameTimings timings;
+	float sim_ms = 0.f; // Written by the sim thread, read after EndStep
+	int emit_interval = 1;
+	QualitySettings applied_quality = QUALITY_LEVELS[0]; // Last solver knobs sent, see PushSolverQuality
+
+	FrameExporter exporter;
+	PixelReadback readback;
+	double capture_ms = 0.0; // Main thread time spent reading frames back
+	int captured_frames = 0;
+
 	void HandleEvent(sf::Event& e);
+	void HandleMouse();
+
+	void SimThreadLoop();
+	void BeginStep();
+	void EndStep();
+
+	void CaptureFrame();
+	void ShowStats();
+	void ApplyQuality(const QualitySettings& settings);
 
 public:
 
-	Simulation();
+	Simulation(const SolverConfig& solver_config = {}, const SimulationConfig& simulation_config = {});
 	~Simulation();
 
 	void Update();
@@ -0,0 +1,387 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "Solver.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#include <immintrin.h>
+#define SOFTWARE_RENDERER_SSE 1
+#else
+#define SOFTWARE_RENDERER_SSE 0
+#endif
+
+constexpr int SOFTWARE_TILE_SIZE = 64; // Pixels per side of a raster task
+constexpr int SOFTWARE_ROW_CHUNK = 16; // Rows per task of the bloom and output passes
+
+constexpr float SOFTWARE_BLOOM_SIGMA = 4.f; // In window pixels, about the glow of the GLSL pyramid at BLOOM_LEVELS
+constexpr float SOFTWARE_BLOOM_STRENGTH = 1.05f; // bloomStrength in CombineBlur.frag
+
+// CPU version of Solver::Render for hosts without a GPU or display. Draws the front snapshot at any
+// resolution into a float RGBA framebuffer and writes RGBA8 pixels. Every pixel is one 4-float vector,
+// so the blending and blur passes run on SSE without shuffles.
+// The whole world is scaled uniformly to fit the output and centered, like a letterboxed view.
+class SoftwareRenderer {
+
+private:
+	int width = 0;
+	int height = 0;
+	float scale = 1.f; // Output pixels per world unit
+	sf::Vector2f offset;
+
+	int tiles_x = 0;
+	int tiles_y = 0;
+
+	// The bloom runs at about half the window resolution whatever the output size, bloom_divisor output pixels per texel
+	int bloom_divisor = 2;
+	int bloom_width = 0;
+	int bloom_height = 0;
+	int row_chunks = 0; // Tasks of the output pass, SOFTWARE_ROW_CHUNK rows each
+	std::vector<float> bloom_weights; // Center tap first, the last pass scales them by BLOOM_GAIN
+	std::vector<int> column_x0; // Left bloom texel and weight of the right one, per output column
+	std::vector<float> column_fx;
+
+	std::vector<float> scene; // RGBA, width * height * 4
+	std::vector<float> bright; // RGBA at bloom resolution, also holds the finished bloom
+	std::vector<float> blur_scratch;
+	std::vector<float> bloom_rows; // One upscaled bloom row per output task, so the tasks don't share it
+	std::vector<uint8_t> pixels;
+
+	// Per particle, filled by the binning pass
+	struct Disk {
+
+		float x, y, radius;
+		float color[4];
+	};
+
+	std::vector<Disk> disks;
+	std::vector<std::vector<int>> tile_disks; // Disk indices per tile, in draw order
+
+	static float Luminance(const float* pixel) {
+
+		return pixel[0] * 0.2126f + pixel[1] * 0.7152f + pixel[2] * 0.0722f;
+	}
+
+	void BuildBloomKernel(int bloom_levels) {
+
+		// Each pyramid level doubles the glow radius of the GLSL path
+		const float sigma = SOFTWARE_BLOOM_SIGMA * std::exp2((float)(bloom_levels - BLOOM_LEVELS)) * scale / bloom_divisor;
+		const int radius = std::max(1, (int)std::ceil(sigma * 3.f));
+
+		bloom_weights.resize(radius + 1);
+
+		float sum = 0.f;
+
+		for (int i = 0; i <= radius; i++) {
+
+			bloom_weights[i] = std::exp(-(float)(i * i) / (2.f * sigma * sigma));
+			sum += i == 0 ? bloom_weights[i] : 2.f * bloom_weights[i];
+		}
+
+		for (float& weight : bloom_weights)
+			weight /= sum;
+	}
+
+	// Copies the visible particles of the snapshot into disks and bins them by tile
+	void BinDisks(const RenderSnapshot& snapshot) {
+
+		for (std::vector<int>& tile : tile_disks)
+			tile.clear();
+
+		disks.clear();
+
+		const int smoke_begin = snapshot.species_begin[(int)Species::Smoke];
+		const int smoke_end = snapshot.species_begin[(int)Species::Inert];
+
+		for (int i = 0; i < snapshot.particle_count; i++) {
+
+			float radius = GetRenderRadius(snapshot, i);
+
+			if (radius <= 0.f) continue;
+
+			Disk disk;
+			disk.x = offset.x + (snapshot.positions[i].x + radius * SPRITE_DISK_X) * scale;
+			disk.y = offset.y + (snapshot.positions[i].y + radius * SPRITE_DISK_Y) * scale;
+			disk.radius = radius * SPRITE_DISK_RADIUS * scale;
+
+			sf::Color color = !snapshot.filled ? sf::Color::White
+				: i >= smoke_begin && i < smoke_end ? SmokeColor(snapshot.temperatures[i]) : TemperatureToColor(snapshot.temperatures[i]);
+
+			disk.color[0] = color.r / 255.f;
+			disk.color[1] = color.g / 255.f;
+			disk.color[2] = color.b / 255.f;
+			disk.color[3] = 1.f;
+
+			// Half a pixel of antialiasing on each side
+			int min_x = std::max(0, (int)std::floor(disk.x - disk.radius - 0.5f) / SOFTWARE_TILE_SIZE);
+			int max_x = std::min(tiles_x - 1, (int)std::floor(disk.x + disk.radius + 0.5f) / SOFTWARE_TILE_SIZE);
+			int min_y = std::max(0, (int)std::floor(disk.y - disk.radius - 0.5f) / SOFTWARE_TILE_SIZE);
+			int max_y = std::min(tiles_y - 1, (int)std::floor(disk.y + disk.radius + 0.5f) / SOFTWARE_TILE_SIZE);
+
+			if (min_x > max_x || min_y > max_y) continue;
+
+			for (int y = min_y; y <= max_y; y++)
+				for (int x = min_x; x <= max_x; x++)
+					tile_disks[y * tiles_x + x].push_back((int)disks.size());
+
+			disks.push_back(disk);
+		}
+	}
+
+	// Clears the tile to opaque black and draws its disks over each other in order, like the alpha blended sprites
+	void RasterTile(int tile) {
+
+		const int tile_x = (tile % tiles_x) * SOFTWARE_TILE_SIZE, tile_y = (tile / tiles_x) * SOFTWARE_TILE_SIZE;
+		const int tile_end_x = std::min(tile_x + SOFTWARE_TILE_SIZE, width), tile_end_y = std::min(tile_y + SOFTWARE_TILE_SIZE, height);
+
+		const float black[4] = { 0.f, 0.f, 0.f, 1.f };
+
+		for (int y = tile_y; y < tile_end_y; y++) {
+
+			float* row = &scene[((size_t)y * width + tile_x) * 4];
+
+			for (int x = 0; x < tile_end_x - tile_x; x++)
+				std::memcpy(row + x * 4, black, sizeof(black));
+		}
+
+		for (int index : tile_disks[tile]) {
+
+			const Disk& disk = disks[index];
+
+			int min_x = std::max(tile_x, (int)std::floor(disk.x - disk.radius - 0.5f));
+			int max_x = std::min(tile_end_x - 1, (int)std::floor(disk.x + disk.radius + 0.5f));
+			int min_y = std::max(tile_y, (int)std::floor(disk.y - disk.radius - 0.5f));
+			int max_y = std::min(tile_end_y - 1, (int)std::floor(disk.y + disk.radius + 0.5f));
+
+#if SOFTWARE_RENDERER_SSE
+			const __m128 color = _mm_loadu_ps(disk.color);
+#endif
+
+			for (int y = min_y; y <= max_y; y++) {
+
+				const float dy = (float)y + 0.5f - disk.y;
+
+				for (int x = min_x; x <= max_x; x++) {
+
+					const float dx = (float)x + 0.5f - disk.x;
+					const float coverage = std::clamp(disk.radius - std::sqrt(dx * dx + dy * dy) + 0.5f, 0.f, 1.f);
+
+					if (coverage <= 0.f) continue;
+
+					float* pixel = &scene[((size_t)y * width + x) * 4];
+
+#if SOFTWARE_RENDERER_SSE
+					__m128 dst = _mm_loadu_ps(pixel);
+					_mm_storeu_ps(pixel, _mm_add_ps(dst, _mm_mul_ps(_mm_sub_ps(color, dst), _mm_set1_ps(coverage))));
+#else
+					for (int c = 0; c < 4; c++)
+						pixel[c] += (disk.color[c] - pixel[c]) * coverage;
+#endif
+				}
+			}
+		}
+	}
+
+	// Box filters bloom_divisor^2 scene pixels into each bloom texel, pixels below BLOOM_THRESHOLD count as black
+	void ExtractBrightness(int begin, int end) {
+
+		const float weight = 1.f / (float)(bloom_divisor * bloom_divisor);
+
+		for (int by = begin; by < end; by++) {
+
+			for (int bx = 0; bx < bloom_width; bx++) {
+
+				float* out = &bright[((size_t)by * bloom_width + bx) * 4];
+
+#if SOFTWARE_RENDERER_SSE
+				__m128 sum = _mm_setzero_ps();
+#else
+				float sum[4] = {};
+#endif
+
+				for (int y = by * bloom_divisor; y < std::min((by + 1) * bloom_divisor, height); y++) {
+
+					for (int x = bx * bloom_divisor; x < std::min((bx + 1) * bloom_divisor, width); x++) {
+
+						const float* pixel = &scene[((size_t)y * width + x) * 4];
+
+						if (Luminance(pixel) <= BLOOM_THRESHOLD) continue;
+
+#if SOFTWARE_RENDERER_SSE
+						sum = _mm_add_ps(sum, _mm_loadu_ps(pixel));
+#else
+						for (int c = 0; c < 4; c++)
+							sum[c] += pixel[c];
+#endif
+					}
+				}
+
+#if SOFTWARE_RENDERER_SSE
+				_mm_storeu_ps(out, _mm_mul_ps(sum, _mm_set1_ps(weight)));
+#else
+				for (int c = 0; c < 4; c++)
+					out[c] = sum[c] * weight;
+#endif
+			}
+		}
+	}
+
+	// One separable Gaussian pass over rows [begin, end) of the bloom buffer.
+	// Taps past the edge are clamped, like the smooth render textures.
+	void BlurRows(const float* src, float* dst, int begin, int end, bool horizontal, float gain) const {
+
+		const int radius = (int)bloom_weights.size() - 1;
+
+		for (int y = begin; y < end; y++) {
+
+			for (int x = 0; x < bloom_width; x++) {
+
+				auto tap = [&](int distance) {
+
+					int sx = horizontal ? std::clamp(x + distance, 0, bloom_width - 1) : x;
+					int sy = horizontal ? y : std::clamp(y + distance, 0, bloom_height - 1);
+
+					return &src[((size_t)sy * bloom_width + sx) * 4];
+				};
+
+				float* out = &dst[((size_t)y * bloom_width + x) * 4];
+
+#if SOFTWARE_RENDERER_SSE
+				__m128 sum = _mm_mul_ps(_mm_loadu_ps(tap(0)), _mm_set1_ps(bloom_weights[0]));
+
+				for (int i = 1; i <= radius; i++)
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(tap(-i)), _mm_loadu_ps(tap(i))), _mm_set1_ps(bloom_weights[i])));
+
+				_mm_storeu_ps(out, _mm_mul_ps(sum, _mm_set1_ps(gain)));
+#else
+				float sum[4];
+
+				for (int c = 0; c < 4; c++)
+					sum[c] = tap(0)[c] * bloom_weights[0];
+
+				for (int i = 1; i <= radius; i++)
+					for (int c = 0; c < 4; c++)
+						sum[c] += (tap(-i)[c] + tap(i)[c]) * bloom_weights[i];
+
+				for (int c = 0; c < 4; c++)
+					out[c] = sum[c] * gain;
+#endif
+			}
+		}
+	}
+
+	// Scene plus the bilinearly upscaled bloom, clamped to RGBA8 like the window framebuffer.
+	// The bloom is interpolated vertically once per row, each pixel then only lerps between two texels of that row.
+	void WritePixels(int chunk) {
+
+		const int begin = chunk * SOFTWARE_ROW_CHUNK;
+		const int end = std::min(begin + SOFTWARE_ROW_CHUNK, height);
+		float* bloom_row = &bloom_rows[(size_t)chunk * bloom_width * 4];
+
+		for (int y = begin; y < end; y++) {
+
+			float by = std::clamp(((float)y + 0.5f) / bloom_divisor - 0.5f, 0.f, (float)(bloom_height - 1));
+			int y0 = (int)by, y1 = std::min(y0 + 1, bloom_height - 1);
+			float fy = by - (float)y0;
+
+			const float* top = &bright[(size_t)y0 * bloom_width * 4];
+			const float* bottom = &bright[(size_t)y1 * bloom_width * 4];
+
+			for (int i = 0; i < bloom_width * 4; i++)
+				bloom_row[i] = (top[i] + (bottom[i] - top[i]) * fy) * SOFTWARE_BLOOM_STRENGTH;
+
+			const float* pixel = &scene[(size_t)y * width * 4];
+			uint8_t* out = &pixels[(size_t)y * width * 4];
+
+			for (int x = 0; x < width; x++) {
+
+				const int x0 = column_x0[x];
+				const float fx = column_fx[x];
+				const float* left = &bloom_row[x0 * 4];
+				const float* right = &bloom_row[std::min(x0 + 1, bloom_width - 1) * 4];
+
+#if SOFTWARE_RENDERER_SSE
+				__m128 l = _mm_loadu_ps(left);
+				__m128 value = _mm_add_ps(_mm_loadu_ps(pixel + x * 4), _mm_add_ps(l, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(right), l), _mm_set1_ps(fx))));
+				value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.f));
+
+				__m128i rgba = _mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps(255.f)));
+				rgba = _mm_packs_epi32(rgba, rgba);
+				rgba = _mm_packus_epi16(rgba, rgba);
+
+				int packed = _mm_cvtsi128_si32(rgba);
+				std::memcpy(out + x * 4, &packed, 4);
+#else
+				for (int c = 0; c < 4; c++) {
+
+					float value = pixel[x * 4 + c] + left[c] + (right[c] - left[c]) * fx;
+					out[x * 4 + c] = (uint8_t)(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+				}
+#endif
+			}
+		}
+	}
+
+public:
+
+	void Resize(int output_width, int output_height, int bloom_levels = BLOOM_LEVELS) {
+
+		width = std::max(1, output_width);
+		height = std::max(1, output_height);
+
+		scale = std::min((float)width / WORLD_WIDTH, (float)height / WORLD_HEIGHT);
+		offset = { (width - WORLD_WIDTH * scale) / 2.f, (height - WORLD_HEIGHT * scale) / 2.f };
+
+		tiles_x = (width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+		tiles_y = (height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+		tile_disks.assign((size_t)tiles_x * tiles_y, {});
+
+		bloom_divisor = 2 * std::max(1, (int)(scale + 0.5f));
+		bloom_width = std::max(1, width / bloom_divisor);
+		bloom_height = std::max(1, height / bloom_divisor);
+		BuildBloomKernel(std::clamp(bloom_levels, 1, MAX_BLOOM_LEVELS));
+
+		column_x0.resize(width);
+		column_fx.resize(width);
+
+		for (int x = 0; x < width; x++) {
+
+			float bx = std::clamp(((float)x + 0.5f) / bloom_divisor - 0.5f, 0.f, (float)(bloom_width - 1));
+			column_x0[x] = (int)bx;
+			column_fx[x] = bx - (float)column_x0[x];
+		}
+
+		scene.assign((size_t)width * height * 4, 0.f);
+		bright.assign((size_t)bloom_width * bloom_height * 4, 0.f);
+		blur_scratch.assign(bright.size(), 0.f);
+
+		row_chunks = (height + SOFTWARE_ROW_CHUNK - 1) / SOFTWARE_ROW_CHUNK;
+		bloom_rows.assign((size_t)row_chunks * bloom_width * 4, 0.f);
+
+		pixels.assign((size_t)width * height * 4, 0);
+	}
+
+	void Render(const RenderSnapshot& snapshot, ThreadPool& pool) {
+
+		BinDisks(snapshot);
+
+		pool.Dispatch(tiles_x * tiles_y, [&](int tile) { RasterTile(tile); });
+
+		pool.ParallelFor(bloom_height, SOFTWARE_ROW_CHUNK, [&](int begin, int end) { ExtractBrightness(begin, end); });
+		pool.ParallelFor(bloom_height, SOFTWARE_ROW_CHUNK, [&](int begin, int end) { BlurRows(bright.data(), blur_scratch.data(), begin, end, true, 1.f); });
+		pool.ParallelFor(bloom_height, SOFTWARE_ROW_CHUNK, [&](int begin, int end) { BlurRows(blur_scratch.data(), bright.data(), begin, end, false, BLOOM_GAIN); });
+
+		pool.Dispatch(row_chunks, [&](int chunk) { WritePixels(chunk); });
+	}
+
+	int GetWidth() const { return width; }
+
+	int GetHeight() const { return height; }
+
+	int GetDrawnCount() const { return (int)disks.size(); }
+
+	// RGBA8, rows top to bottom
+	const std::vector<uint8_t>& GetPixels() const { return pixels; }
+};
@@ -1,19 +1,194 @@
 #pragma once
 #include "Particle.h"
+#include "Palette.h"
+#include "ThermalKernel.h"
+#include "ThermalGrid.h"
+#include "HeatSourceMap.h"
+#include "Species.h"
 #include <vector>
 #include <algorithm>
+#include <memory>
+#include <cstdint>
+#include <bit>
 #include "Collision_Grid.h"
+#include "ThreadPool.h"
+#include "Random.h"
+#include "CommandQueue.h"
+#include "Camera.h"
+#include "SFML/OpenGL.hpp"
+
+// Point sprite switches, past the OpenGL 1.1 headers shipped on Windows
+#ifndef GL_VERTEX_PROGRAM_POINT_SIZE
+#define GL_VERTEX_PROGRAM_POINT_SIZE 0x8642
+#endif
+#ifndef GL_POINT_SPRITE
+#define GL_POINT_SPRITE 0x8861
+#endif
 
 #define FIRE 1
 
 constexpr int WINDOW_WIDTH = 800;
 constexpr int WINDOW_HEIGHT = 600;
+
+// Simulated domain, may be larger than the window. The camera shows a part of it.
+constexpr int WORLD_WIDTH = WINDOW_WIDTH;
+constexpr int WORLD_HEIGHT = WINDOW_HEIGHT;
 constexpr int CELL_SIZE = (int)PARTICLE_RADIUS;
 
-constexpr int GRID_WIDTH = WINDOW_WIDTH / CELL_SIZE;
-constexpr int GRID_HEIGHT = WINDOW_HEIGHT / CELL_SIZE;
+constexpr int GRID_WIDTH = WORLD_WIDTH / CELL_SIZE;
+constexpr int GRID_HEIGHT = WORLD_HEIGHT / CELL_SIZE;
+
+constexpr int MAX_PARTICLES = 10000; // Upper limit, the particle cap can be lowered at runtime
+constexpr int SUB_STEPS = 8;
+
+constexpr int VERTEX_BLOCK = 2048; // Particles per task of the vertex build
+
+// View culling. The snapshot lists the particles of every tile of collision cells, the vertex build
+// only goes through the tiles the camera overlaps.
+constexpr int CULL_TILE_CELLS = 8; // Tile edge in collision cells
+constexpr int CULL_TILES_X = (GRID_WIDTH + CULL_TILE_CELLS - 1) / CULL_TILE_CELLS;
+constexpr int CULL_TILES_Y = (GRID_HEIGHT + CULL_TILE_CELLS - 1) / CULL_TILE_CELLS;
+
+// Bloom pyramid below the half resolution brightness level. Each level halves the size and roughly doubles the glow radius;
+// 2 levels give about the radius of the 13-tap blur at full resolution this replaced.
+constexpr int BLOOM_LEVELS = 2;
+constexpr int MAX_BLOOM_LEVELS = 6;
+constexpr float BLOOM_GAIN = 17.f; // The two blur passes it replaced each summed to 1.38 and were scaled by 3
+constexpr float BLOOM_THRESHOLD = 0.01f; // Luminance a scene pixel needs to contribute to the bloom
+constexpr float BLOOM_HISTORY_WEIGHT = 0.5f; // Of a recomputed bloom against the history, when not recomputed every frame
+constexpr int MAX_BLOOM_INTERVAL = 8;
+
+constexpr float PIXEL_SIZE = 5.f; // Of the pixelated view
+
+constexpr float GRAVITY = 1500.f;
+
+constexpr float HEAT_BAND_HEIGHT = 25.f; // Default heat source, a strip along the bottom of the world
+
+// Particles cooler than this, outside any heat source, leave the hot set and are snapped to 0
+constexpr float HOT_TEMPERATURE = 1.f;
+
+constexpr float THERMAL_CELL_SIZE = 16.f;
+constexpr float THERMAL_DIFFUSION_RATE = 20.f; // Fraction exchanged with each grid neighbour per second
+constexpr float THERMAL_GATHER_RATE = 3.f; // How fast particles follow the grid temperature, per second
+
+// How heat moves between particles
+enum class ThermalMode {
+	Contact, // Pairwise averaging in SolveCells, only between touching particles
+	Grid, // Splat to a coarse grid, diffuse, gather back
+	Both
+};
+
+// Row height of a collision band in deterministic mode. It doesn't depend on the thread count,
+// so the order in which contacts are solved is the same on 1 or 32 threads.
+constexpr int DETERMINISTIC_BAND_ROWS = 4;
+
+// Spatial level of detail. Tiles with no hot or moving particle nearby are integrated every 2nd or 4th substep.
+constexpr int LOD_TILE_CELLS = 8; // Tile edge in collision cells
+constexpr int LOD_TILES_X = (GRID_WIDTH + LOD_TILE_CELLS - 1) / LOD_TILE_CELLS;
+constexpr int LOD_TILES_Y = (GRID_HEIGHT + LOD_TILE_CELLS - 1) / LOD_TILE_CELLS;
+constexpr float LOD_QUIET_SPEED = 0.1f; // Pixels per substep, slower cold particles count as resting
+constexpr int LOD_HALF_RATE_DISTANCE = 3; // In tiles from the nearest active one. Adjacent tiles always run at full rate.
+
+struct SolverConfig {
+
+	int thread_count = (int)std::max(1u, std::thread::hardware_concurrency());
+	int render_thread_count = (int)std::max(1u, std::thread::hardware_concurrency() / 2);
+	bool deterministic = true;
+	uint64_t seed = 0;
+
+	ThermalMode thermal_mode = ThermalMode::Contact;
+	std::string heat_map_path; // Optional, see HeatSourceMap::LoadFromFile. Replaces the bottom band.
+	int thermal_steps_per_frame = 0; // Thermal updates per frame, spread over the substeps. 0 = every substep.
+
+	// Picks the substep count per frame from the last frame's motion instead of the fixed 8
+	bool adaptive_substeps = false;
+	int min_substeps = 2;
+	int max_substeps = 16;
+
+	bool spatial_lod = false; // See LOD_TILE_CELLS
+
+	bool species = false; // Emitters spawn fuel that burns through flame and smoke, otherwise everything is inert
+
+	bool vertex_array = false; // Draws from the client-side sf::VertexArray instead of a streamed sf::VertexBuffer
+
+	int bloom_levels = BLOOM_LEVELS;
+	int bloom_interval = 1; // Frames between bloom updates, the ones in between reuse the blended history
+
+	bool headless = false; // GpuResources isn't created, so no OpenGL context or display is needed. Render must not be called. See SoftwareRenderer.
 
-constexpr int MAX_PARTICLES = 10000;
+	bool procedural_sprite = false; // Particles are shaded by ParticleSprite.frag instead of sampling circle.png
+
+	bool compact_vertices = false; // Uploads one CompactVertex per particle and draws points instead of sf::Vertex triangles
+
+	// Core isolation, see ThreadPoolConfig. The sim thread settings apply to the thread calling UpdateSolver.
+	uint64_t affinity_mask = 0;
+	uint64_t render_affinity_mask = 0;
+	uint64_t sim_affinity_mask = 0;
+	bool sim_realtime = false;
+	int sim_nice = 0;
+	int spin_count = 2000;
+};
+
+enum class SolverCommandType {
+	Spawn, // One particle at position
+	SpawnBurst, // count particles scattered within radius of position
+	HeatBrush, // Adds amount degrees to every particle within radius of position
+	SetGravity, // Vertical gravity set to amount
+	SetThermalMode, // ThermalMode in count
+	PaintHeatSource, // Heat source of intensity amount within radius of position
+	ResetHeatSources, // Back to the default bottom band
+	SetSubSteps, // Substeps per frame in count, the upper limit with adaptive substepping. 0 = default.
+	SetParticleCap // Spawning stops at count particles, the highest ids are removed when above it (inert first with species)
+};
+
+// Input for the solver thread. Applied at the start of the next substep.
+struct SolverCommand {
+
+	SolverCommandType type = SolverCommandType::Spawn;
+	sf::Vector2f position;
+	float radius = 0.f;
+	float amount = 0.f;
+	int count = 0;
+};
+
+constexpr size_t COMMAND_QUEUE_SIZE = 1024;
+
+// Measured over the last frame
+struct SolverStats {
+
+	int sub_steps = 0;
+	int thermal_steps = 0;
+	float max_displacement = 0.f; // Largest distance a particle moved in one substep
+	float mean_penetration = 0.f; // Average overlap of the contacts found by the collision solver
+	int hot_particles = 0;
+	int full_rate_tiles = 0; // Only with spatial LOD
+	int half_rate_tiles = 0;
+	int quarter_rate_tiles = 0;
+};
+
+// Adaptive substepping keeps the per-substep motion and the average overlap below these.
+// Tuned so the default scene settles around the fixed 8 substeps.
+constexpr float TARGET_DISPLACEMENT = PARTICLE_RADIUS * 0.75f;
+constexpr float TARGET_PENETRATION = PARTICLE_RADIUS * 0.75f;
+
+// Copy of everything UpdateVA needs, so vertices can be built while the solver advances
+struct RenderSnapshot {
+
+	std::vector<sf::Vector2f> positions;
+	std::vector<float> radii;
+	std::vector<float> temperatures;
+
+	int particle_count = 0;
+	bool filled = false; // Particles are drawn white until the solver first reached its cap
+
+	std::array<int, SPECIES_COUNT + 1> species_begin = {}; // Species s is [species_begin[s], species_begin[s + 1])
+
+	// Particles of cull tile t are tile_ids[tile_begin[t]..tile_begin[t + 1]), tiles in rows of CULL_TILES_X
+	std::vector<int> tile_begin;
+	std::vector<int> tile_ids;
+
+	SolverStats stats;
+};
 
 static float LerpRadius(float from, float to, float dt) {
 
@@ -22,6 +197,58 @@ static float LerpRadius(float from, float to, float dt) {
 	return new_r;
 }
 
+// Drawn radius after the FIRE shrink, 0 for particles that aren't drawn at all
+static float GetRenderRadius(const RenderSnapshot& snapshot, int i) {
+
+	float radius = snapshot.radii[i];
+
+	if (snapshot.filled && FIRE) {
+
+		radius = LerpRadius(0.f, RENDER_RADIUS, (snapshot.temperatures[i] / 1500.f));
+
+		if (radius < RENDER_RADIUS / 4.f)
+			radius = 0.f;
+	}
+
+	return radius;
+}
+
+// The disk of circle.png as the sprite triangle maps it, relative to the particle position in units of the drawn radius
+constexpr float SPRITE_DISK_X = -0.36f;
+constexpr float SPRITE_DISK_Y = -0.6f;
+constexpr float SPRITE_DISK_RADIUS = 0.395f;
+
+// Fixed point scales of CompactVertex
+constexpr float COMPACT_POSITION_SCALE = 32.f; // Positions up to 1023 pixels
+constexpr float COMPACT_RADIUS_SCALE = 256.f;
+constexpr float COMPACT_TEMPERATURE_SCALE = 32767.f / MAX_TEMPERATURE;
+
+static_assert(std::max(WORLD_WIDTH, WORLD_HEIGHT) * COMPACT_POSITION_SCALE <= 32767.f, "World too large for CompactVertex positions");
+
+// One per visible particle, drawn as a point sprite by CompactParticle.vert. Replaces three 20 byte sf::Vertex,
+// the color comes from a palette texture and the disk is computed in the shader.
+struct CompactVertex {
+
+	int16_t x, y;
+	int16_t temperature;
+	int16_t radius; // Drawn radius, negative for smoke
+};
+
+
+// Everything that owns an OpenGL object. Constructing any of these creates SFML's shared context, which needs a display,
+// so the solver only builds them when it isn't headless.
+struct GpuResources {
+
+	sf::VertexBuffer vertex_buffer{ sf::Triangles, sf::VertexBuffer::Stream }; // Updated in place from va every frame
+	sf::Texture particle_texture;
+	sf::Shader sprite; // Used instead of particle_texture when use_procedural_sprite
+	sf::Shader compact_shader;
+	sf::Texture palette_texture;
+	sf::Shader downsample, upsample, combine, blend;
+	sf::RenderTexture sceneTexture;
+	sf::RenderTexture bloomHistory[2]; // Ping-pong, only used with a bloom interval above 1
+	std::vector<std::unique_ptr<sf::RenderTexture>> bloom_chain; // Half resolution level first, bloom_levels smaller ones after it
+};
 
 class Solver {
 
@@ -29,21 +256,100 @@ private:
 
 	bool pixelated = false;
 
+	SolverConfig config;
+	Random rng;
+	std::unique_ptr<ThreadPool> pool;
+	std::unique_ptr<ThreadPool> render_pool; // Separate, the vertex build runs alongside the solver
+
 	float m_dt = 1.f / 60.f;
-	int sub_steps = 8;
+	int sub_steps = SUB_STEPS;
 	float sub_dt = m_dt / (float)(sub_steps);
+	int substep_limit = 0; // Set through SetSubSteps commands, 0 = no limit
+
+	int particle_cap = MAX_PARTICLES;
+	bool filled = false; // Set once the count first reaches the cap. Heat only runs after that, so the pile can settle first.
+
+	int bloom_downscale = 1; // The first bloom level is half the window size / bloom_downscale
+	int bloom_levels = BLOOM_LEVELS;
+	int bloom_interval = 1;
+	int render_frame = 0;
+	int history_index = 0; // bloomHistory[history_index] holds the bloom shown last frame
+	bool history_valid = false; // The next update replaces the history instead of blending into it
 
-	sf::Vector2f gravity = { 0.f, 1500.f };
+	sf::Vector2f gravity = { 0.f, GRAVITY };
 	sf::VertexArray va{ sf::Triangles }; // Needs to use a special texture
-	sf::Texture particle_texture;
-	sf::Shader brightExtract, blurH, blurV, combine, pixelate;
-	sf::RenderTexture sceneTexture, brightnessTexture, blurTextureH, blurTextureV, finalTexture;
-	sf::Texture sceneTextureRef;
+	bool use_vertex_buffer = false;
+	size_t upload_bytes = 0; // Vertex data handed to the driver in the last frame
+	std::vector<int> block_offsets; // Prefix sum of visible particles per VERTEX_BLOCK, see UpdateVA
+	int visible_count = 0; // Particles with vertices in va, packed at the front
+	Camera camera{ { (float)WINDOW_WIDTH, (float)WINDOW_HEIGHT }, { (float)WORLD_WIDTH, (float)WORLD_HEIGHT } };
+	bool culling = false; // The camera shows part of the world, the vertex build only goes through culled_ids
+	std::vector<int> culled_ids; // Particles in the tiles the camera overlaps, in id order
+	std::vector<uint64_t> culled_bits; // One bit per particle, see CullToCamera
+	std::array<int, SPECIES_COUNT + 1> draw_species_begin = {}; // Species ranges in the order of the vertex build
+	bool use_procedural_sprite = false; // GpuResources::sprite instead of particle_texture
+	std::vector<CompactVertex> compact_vertices; // Packed like va, visible_count used
+	bool use_compact_vertices = false;
+	std::unique_ptr<GpuResources> gpu; // Null when headless
 
 	std::vector<std::pair<int, int>> particles_grid_positions; // Holds a particle grid position on it's ID index
 
 	std::vector<Particle> particles;
 
+	// Thermal state as SoA, indexed by particle id
+	std::vector<float> temperatures;
+	std::vector<float> buoyancy; // Upward acceleration from the last thermal update, 0 for cold particles
+
+	// Sparse set of particles that are hot or sit in a heat source. Only these go through the thermal kernel.
+	std::vector<int> hot_ids;
+	std::vector<uint8_t> is_hot; // Per id. Bytes rather than vector<bool>, bands write them concurrently.
+	// Per collision band results, merged in band order once all bands finished
+	struct BandResult {
+
+		std::vector<int> hot_ids; // Particles heated by contact this substep
+		double penetration_sum = 0.0;
+		int contacts = 0;
+	};
+
+	std::vector<BandResult> band_results;
+	double penetration_sum = 0.0; // Over the current frame
+	int contacts = 0;
+	SolverStats stats;
+
+	// Scratch for the kernel, packed in hot_ids order
+	std::vector<float> hot_temperatures;
+	std::vector<float> hot_heat;
+	std::vector<float> hot_buoyancy;
+	std::array<ThermalParams, SPECIES_COUNT> species_params = SPECIES_THERMAL_PARAMS;
+	std::array<int, SPECIES_COUNT + 1> hot_species_begin = {}; // Same for hot_ids, after SortHotBySpecies
+	std::vector<int> hot_scratch;
+
+	// Particle storage is sorted by species, species_begin[SPECIES_COUNT] is the particle count
+	std::array<int, SPECIES_COUNT + 1> species_begin = {};
+
+	// Batched id remapping for SwapParticles, see FlushSwaps
+	std::vector<int> swap_origin; // Per index, the id the particle had before the batch
+	std::vector<int> swap_target; // Per old id, its index after the batch
+	std::vector<int> swapped; // Indices touched in the batch
+	ThermalGrid thermal_grid;
+	HeatSourceMap heat_sources;
+	std::atomic<int> particle_count{ 0 }; // Readable from other threads while the solver runs
+
+	// Spatial LOD state. Rates are picked once per frame, due tiles once per substep.
+	std::vector<uint8_t> tile_rate; // Substeps per integration, 1, 2 or 4
+	std::vector<uint8_t> tile_due; // Integrated in the current substep
+	std::vector<int> tile_distance; // Scratch, tiles to the nearest active tile
+	std::vector<int> due_ids;
+	std::vector<int64_t> last_update; // Per id, substep_counter after the particle was last integrated
+	std::vector<uint8_t> last_steps; // Per id, substeps covered by that integration
+	int64_t substep_counter = 0;
+
+	SpscQueue<SolverCommand, COMMAND_QUEUE_SIZE> commands;
+
+	// Double buffered render state. The solver writes the back one, UpdateVA reads the front one.
+	RenderSnapshot snapshots[2];
+	int front_snapshot = 0;
+
 	void AddParticle(sf::Vector2f position, float radius = PARTICLE_RADIUS) {
 
 		// Prevent spawning particles too close together
@@ -60,60 +366,436 @@ private:
 		collision_grid.cells[grid_position_y * GRID_WIDTH + grid_position_x].particle_ids.push_back((int)particles.size());
 		particles_grid_positions.push_back({ grid_position_x, grid_position_y });
 		particles.push_back(particle);
+		temperatures.push_back(0.f);
+		buoyancy.push_back(0.f);
+		is_hot.push_back(0);
+		last_update.push_back(substep_counter);
+		last_steps.push_back(1);
+		swap_origin.push_back((int)swap_origin.size());
+		swap_target.push_back((int)swap_target.size());
+		particle_count = (int)particles.size();
+
+		// Appended to the last range, then moved down to its own by swapping with the first particle of each range above
+		int id = (int)particles.size() - 1;
+		const int species = config.species ? (int)Species::Fuel : (int)Species::Inert;
+
+		species_begin[SPECIES_COUNT] = (int)particles.size();
+
+		for (int s = SPECIES_COUNT - 1; s > species; s--) {
+
+			SwapParticles(id, species_begin[s]);
+			id = species_begin[s]++;
+		}
+
+		FlushSwaps();
+
+		if ((int)particles.size() >= particle_cap)
+			filled = true;
+
+		if (heat_sources.Lookup(position) > 0.f)
+			MarkHot(id);
+	}
+
+	int GetSpecies(int id) const {
+
+		return (id >= species_begin[1]) + (id >= species_begin[2]) + (id >= species_begin[3]);
+	}
+
+	// Exchanges everything stored per id between a and b, including the ids in the collision cells.
+	// hot_ids isn't touched here, FlushSwaps remaps it once per batch.
+	void SwapParticles(int a, int b) {
+
+		if (a == b) return;
+
+		CollisionCell& cell_a = collision_grid.cells[particles_grid_positions[a].second * GRID_WIDTH + particles_grid_positions[a].first];
+		CollisionCell& cell_b = collision_grid.cells[particles_grid_positions[b].second * GRID_WIDTH + particles_grid_positions[b].first];
+		int index_a = FindParticleIDIndex(cell_a, a), index_b = FindParticleIDIndex(cell_b, b);
+
+		if (index_a != -1) cell_a.particle_ids[index_a] = b;
+		if (index_b != -1) cell_b.particle_ids[index_b] = a;
+
+		std::swap(particles[a], particles[b]);
+		particles[a].id = a;
+		particles[b].id = b;
+
+		std::swap(particles_grid_positions[a], particles_grid_positions[b]);
+		std::swap(temperatures[a], temperatures[b]);
+		std::swap(buoyancy[a], buoyancy[b]);
+		std::swap(is_hot[a], is_hot[b]);
+		std::swap(last_update[a], last_update[b]);
+		std::swap(last_steps[a], last_steps[b]);
+
+		if (swap_origin[a] == a) swapped.push_back(a);
+		if (swap_origin[b] == b) swapped.push_back(b);
+
+		std::swap(swap_origin[a], swap_origin[b]);
+	}
+
+	// Renames the ids in hot_ids after a batch of swaps, keeping their order
+	void FlushSwaps() {
+
+		if (swapped.empty()) return;
+
+		for (int index : swapped)
+			swap_target[swap_origin[index]] = index;
+
+		for (int& id : hot_ids)
+			id = swap_target[id];
+
+		for (int index : swapped) {
+
+			swap_target[swap_origin[index]] = swap_origin[index];
+			swap_origin[index] = index;
+		}
+
+		swapped.clear();
+	}
+
+	// Moves every particle of species s meeting condition to species s + 1. Walks the range backwards,
+	// so the particle swapped into place has already been checked.
+	template <typename Condition>
+	void ConvertRange(int s, Condition condition) {
+
+		int end = species_begin[s + 1];
+
+		for (int id = end - 1; id >= species_begin[s]; id--) {
+
+			if (condition(id))
+				SwapParticles(id, --end);
+		}
+
+		species_begin[s + 1] = end;
+	}
+
+	// Smoke first, so a particle moves at most one species per substep
+	void ConvertSpecies() {
+
+		ConvertRange((int)Species::Smoke, [&](int id) { return !is_hot[id]; });
+		ConvertRange((int)Species::Flame, [&](int id) { return temperatures[id] < EXTINCTION_TEMPERATURE; });
+		ConvertRange((int)Species::Fuel, [&](int id) { return temperatures[id] >= IGNITION_TEMPERATURE; });
+
+		FlushSwaps();
+	}
+
+	// Removes the particles with the highest ids down to count. Ids stay contiguous since they are removed from the back.
+	// Without species that's the newest ones; with species new particles are swapped into the fuel range at the front,
+	// so the cold inert ones at the back go first and then smoke.
+	void TrimParticles(int count) {
+
+		if ((int)particles.size() <= count) return;
+
+		for (int id = (int)particles.size() - 1; id >= count; id--) {
+
+			auto [grid_position_x, grid_position_y] = particles_grid_positions[id];
+
+			if (grid_position_x >= 0 && grid_position_y >= 0 && grid_position_x < GRID_WIDTH && grid_position_y < GRID_HEIGHT) {
+
+				CollisionCell& cell = collision_grid.cells[grid_position_y * GRID_WIDTH + grid_position_x];
+				int index = FindParticleIDIndex(cell, id);
+
+				if (index != -1)
+					cell.particle_ids.erase(cell.particle_ids.begin() + index);
+			}
+		}
+
+		// Keeps the order of the remaining hot ids
+		hot_ids.erase(std::remove_if(hot_ids.begin(), hot_ids.end(), [&](int id) { return id >= count; }), hot_ids.end());
+
+		particles.resize(count);
+		particles_grid_positions.resize(count);
+		temperatures.resize(count);
+		buoyancy.resize(count);
+		is_hot.resize(count);
+		last_update.resize(count);
+		last_steps.resize(count);
+		swap_origin.resize(count);
+		swap_target.resize(count);
+		particle_count = count;
+
+		for (int& begin : species_begin)
+			begin = std::min(begin, count);
 	}
 
 	void LoadTexture(const char* texture_path) {
 
-		if (!particle_texture.loadFromFile(texture_path)) {
+		if (!gpu->particle_texture.loadFromFile(texture_path)) {
 
 			std::cerr << "Failed to load texture\n";
 			return;
 		}
 
-		particle_texture.setSmooth(false);
+		gpu->particle_texture.setSmooth(false);
 	}
 
-	void ApplyGravity() {
+	std::unique_ptr<ThreadPool> MakePool(int thread_count, uint64_t affinity_mask) const {
+
+		ThreadPoolConfig pool_config;
+		pool_config.thread_count = std::max(1, thread_count);
+		pool_config.affinity_mask = affinity_mask;
+		pool_config.spin_count = config.spin_count;
 
-		for (auto& particle : particles)
-			particle.Accelerate(gravity);
+		return std::make_unique<ThreadPool>(pool_config);
 	}
 
+	void ApplyHeatBrush(sf::Vector2f position, float radius, float amount) {
 
-	void SolveBorderCollisions() {
+		int min_x = std::max(0, (int)((position.x - radius) / CELL_SIZE)), max_x = std::min(GRID_WIDTH - 1, (int)((position.x + radius) / CELL_SIZE));
+		int min_y = std::max(0, (int)((position.y - radius) / CELL_SIZE)), max_y = std::min(GRID_HEIGHT - 1, (int)((position.y + radius) / CELL_SIZE));
 
-		for (auto& particle : particles) {
+		for (int y = min_y; y <= max_y; y++) {
 
-			float velocity_loss_factor = 1.f;
-			float dampening = 0.85f;
-			sf::Vector2f position = particle.position;
+			for (int x = min_x; x <= max_x; x++) {
 
+				for (int id : collision_grid.GetCell(y * GRID_WIDTH + x).particle_ids) {
 
-			//Horizontal
-			if (position.x < particle.radius || position.x + particle.radius > WINDOW_WIDTH) {
+					Particle& particle = particles[id];
+					sf::Vector2f dir = particle.position - position;
 
-				particle.position.x = position.x < particle.radius ? particle.radius : WINDOW_WIDTH - particle.radius;
-				particle.SetVelocity({ -particle.GetVelocity().x, particle.GetVelocity().y * dampening }, velocity_loss_factor);
+					if (dir.x * dir.x + dir.y * dir.y <= radius * radius) {
+
+						temperatures[id] = std::min(temperatures[id] + amount, MAX_TEMPERATURE);
+						MarkHot(id);
+					}
+				}
 			}
-			
-			//Vertical
-			if (position.y < particle.radius || position.y + particle.radius > WINDOW_HEIGHT) {
+		}
+	}
+
+	void ExecuteCommand(const SolverCommand& command) {
+
+		switch (command.type) {
 
-				particle.position.y = position.y < particle.radius ? particle.radius : WINDOW_HEIGHT - particle.radius;
-				particle.SetVelocity({ particle.GetVelocity().x * dampening, -particle.GetVelocity().y }, velocity_loss_factor);
+		case SolverCommandType::Spawn:
+			Spawn(command.position);
+			break;
+
+		case SolverCommandType::SpawnBurst:
+			for (int i = 0; i < command.count; i++) {
+
+				sf::Vector2f offset = { (rng.NextFloat() * 2.f - 1.f) * command.radius, (rng.NextFloat() * 2.f - 1.f) * command.radius };
+				Spawn(command.position + offset);
 			}
+			break;
+
+		case SolverCommandType::HeatBrush:
+			ApplyHeatBrush(command.position, command.radius, command.amount);
+			break;
+
+		case SolverCommandType::SetGravity:
+			gravity.y = command.amount;
+			break;
+
+		case SolverCommandType::SetThermalMode:
+			config.thermal_mode = (ThermalMode)command.count;
+			break;
+
+		case SolverCommandType::PaintHeatSource:
+			heat_sources.FillCircle(command.position, command.radius, command.amount);
+			RebuildHotSet();
+			break;
+
+		case SolverCommandType::ResetHeatSources:
+			ResetHeatSources();
+			RebuildHotSet();
+			break;
+
+		// Picked up by ChooseSubSteps at the start of the next frame
+		case SolverCommandType::SetSubSteps:
+			substep_limit = std::max(0, command.count);
+			break;
+
+		case SolverCommandType::SetParticleCap:
+			particle_cap = std::clamp(command.count, 0, MAX_PARTICLES);
+			TrimParticles(particle_cap);
+			break;
+		}
+	}
+
+	void DrainCommands() {
+
+		SolverCommand command;
+
+		while (commands.Pop(command))
+			ExecuteCommand(command);
+	}
+
+	// Gravity plus the buoyancy of the last thermal update, which stays in effect until the next one
+	void ApplyGravity() {
+
+		pool->ParallelFor((int)particles.size(), 256, [&](int begin, int end) {
+
+			for (int i = begin; i < end; i++)
+				particles[i].Accelerate({ gravity.x, gravity.y + buoyancy[i] });
+		});
+	}
+
+
+	void SolveBorderCollisions() {
+
+		pool->ParallelFor((int)particles.size(), 256, [&](int begin, int end) {
+
+			for (int i = begin; i < end; i++)
+				SolveBorderCollision(particles[i]);
+		});
+	}
+
+	void SolveBorderCollision(Particle& particle) {
+
+		float velocity_loss_factor = 1.f;
+		float dampening = 0.85f;
+		sf::Vector2f position = particle.position;
+
+
+		//Horizontal
+		if (position.x < particle.radius || position.x + particle.radius > WORLD_WIDTH) {
+
+			particle.position.x = position.x < particle.radius ? particle.radius : WORLD_WIDTH - particle.radius;
+			particle.SetVelocity({ -particle.GetVelocity().x, particle.GetVelocity().y * dampening }, velocity_loss_factor);
+		}
+		
+		//Vertical
+		if (position.y < particle.radius || position.y + particle.radius > WORLD_HEIGHT) {
+
+			particle.position.y = position.y < particle.radius ? particle.radius : WORLD_HEIGHT - particle.radius;
+			particle.SetVelocity({ particle.GetVelocity().x * dampening, -particle.GetVelocity().y }, velocity_loss_factor);
+		}
+	}
+
+	// Particle centers within this band of the window bottom touch it with their edge
+	void ResetHeatSources() {
+
+		heat_sources.Clear();
+		heat_sources.FillRect(0.f, WORLD_HEIGHT - HEAT_BAND_HEIGHT - PARTICLE_RADIUS, (float)WORLD_WIDTH, HEAT_BAND_HEIGHT + PARTICLE_RADIUS, 1.f);
+	}
+
+	void MarkHot(int id) {
+
+		if (is_hot[id]) return;
+
+		is_hot[id] = 1;
+		hot_ids.push_back(id);
+	}
+
+	// Full rescan, only needed when the heat sources change under particles that aren't moving
+	void RebuildHotSet() {
+
+		hot_ids.clear();
+
+		for (const auto& particle : particles) {
+
+			is_hot[particle.id] = 0;
+
+			if (temperatures[particle.id] >= HOT_TEMPERATURE || heat_sources.Lookup(particle.position) > 0.f)
+				MarkHot(particle.id);
 		}
 	}
 
+	// Stable counting sort, so each species' hot particles form one span the kernel can run over with its own parameters.
+	// With everything inert it keeps the order as it is.
+	void SortHotBySpecies() {
+
+		std::array<int, SPECIES_COUNT + 1> offsets = {};
+
+		for (int id : hot_ids)
+			offsets[GetSpecies(id) + 1]++;
+
+		for (int s = 0; s < SPECIES_COUNT; s++)
+			offsets[s + 1] += offsets[s];
+
+		hot_species_begin = offsets;
+		hot_scratch.resize(hot_ids.size());
+
+		for (int id : hot_ids)
+			hot_scratch[offsets[GetSpecies(id)]++] = id;
+
+		hot_ids.swap(hot_scratch);
+	}
+
+	// Gathers the hot particles into packed arrays, runs the batched kernel on them and scatters the result back.
+	// Buoyancy is applied in ApplyGravity. Cost follows the size of the flame rather than the particle count.
 	void ApplyTemperature(float dt) {
 
-		for (auto& particle : particles) {
+		SortHotBySpecies();
+
+		const int hot_count = (int)hot_ids.size();
+
+		hot_temperatures.resize(hot_count);
+		hot_heat.resize(hot_count);
+		hot_buoyancy.resize(hot_count);
+
+		pool->ParallelFor(hot_count, 256, [&](int begin, int end) {
 
-			particle.TemperatureBehavior(WINDOW_HEIGHT, WINDOW_WIDTH, dt);
+			for (int i = begin; i < end; i++) {
+
+				hot_temperatures[i] = temperatures[hot_ids[i]];
+				hot_heat[i] = heat_sources.Lookup(particles[hot_ids[i]].position);
+			}
+
+			// The chunk split at species boundaries, no per-particle branches in the kernel
+			for (int s = 0; s < SPECIES_COUNT; s++) {
+
+				const int span_begin = std::max(begin, hot_species_begin[s]), span_end = std::min(end, hot_species_begin[s + 1]);
+
+				if (span_begin < span_end)
+					ThermalKernel(&hot_temperatures[span_begin], &hot_heat[span_begin], &hot_buoyancy[span_begin], span_end - span_begin, species_params[s], dt);
+			}
+
+			for (int i = begin; i < end; i++) {
+
+				temperatures[hot_ids[i]] = hot_temperatures[i];
+				buoyancy[hot_ids[i]] = hot_buoyancy[i];
+			}
+		});
+
+		// Drop particles that cooled down outside any heat source. Serial, so the set order stays reproducible.
+		int kept = 0;
+
+		for (int i = 0; i < hot_count; i++) {
+
+			int id = hot_ids[i];
+
+			if (hot_temperatures[i] < HOT_TEMPERATURE && hot_heat[i] <= 0.f) {
+
+				temperatures[id] = 0.f;
+				buoyancy[id] = 0.f;
+				is_hot[id] = 0;
+			}
+			else {
+
+				hot_ids[kept++] = id;
+			}
 		}
+
+		hot_ids.resize(kept);
+	}
+
+	void ExchangeHeatGrid(float dt) {
+
+		thermal_grid.Clear();
+
+		// Serial, so the summation order doesn't depend on the thread count
+		for (const auto& particle : particles)
+			thermal_grid.Splat(particle.position, temperatures[particle.id]);
+
+		thermal_grid.Diffuse(THERMAL_DIFFUSION_RATE * dt);
+
+		const float blend = std::min(1.f, THERMAL_GATHER_RATE * dt);
+
+		pool->ParallelFor((int)particles.size(), 256, [&](int begin, int end) {
+
+			for (int i = begin; i < end; i++)
+				temperatures[i] += (thermal_grid.Sample(particles[i].position) - temperatures[i]) * blend;
+		});
+
+		// The grid reaches every particle, so here the hot set has to be refreshed in full
+		for (const auto& particle : particles)
+			if (temperatures[particle.id] >= HOT_TEMPERATURE)
+				MarkHot(particle.id);
 	}
 
-	void SolveCells(CollisionCell& curr, CollisionCell& other, float dt) {
+	void SolveCells(CollisionCell& curr, CollisionCell& other, float dt, BandResult& result) {
+
+		const bool contact_heat = config.thermal_mode != ThermalMode::Grid;
 
 		for (auto& idx_1 : curr.particle_ids) {
 
@@ -135,27 +817,43 @@ private:
 					sf::Vector2f normalized_dir = dir / root_dst;
 					float delta = 0.5f * (min_dst - root_dst);
 
+					result.penetration_sum += min_dst - root_dst;
+					result.contacts++;
+
 
 					float correction_factor = 0.2f; // Makes sure the simulation doesn't explode
 
 					curr_particle.position += normalized_dir * delta * 0.5f * correction_factor;
 					other_particle.position -= normalized_dir * delta * 0.5f * correction_factor;
 
+					if (!contact_heat) continue;
+
+					// Nothing to exchange between two cold particles
+					if (!is_hot[idx_1] && !is_hot[idx_2]) continue;
+
 					// Temperature transfer on collision
-					float total_temp = curr_particle.temperature + other_particle.temperature;
+					float& curr_temp = temperatures[idx_1];
+					float& other_temp = temperatures[idx_2];
+
+					float total_temp = curr_temp + other_temp;
 					total_temp /= 2.f;
 
-					curr_particle.temperature += (total_temp - curr_particle.temperature) * 0.5f * dt;
-					other_particle.temperature += (total_temp - other_particle.temperature) * 0.5f * dt;
+					curr_temp += (total_temp - curr_temp) * 0.5f * dt;
+					other_temp += (total_temp - other_temp) * 0.5f * dt;
+
+					// The cold one just got heated, MarkHot would race on hot_ids so it's queued per band
+					if (!is_hot[idx_1]) { is_hot[idx_1] = 1; result.hot_ids.push_back(idx_1); }
+					if (!is_hot[idx_2]) { is_hot[idx_2] = 1; result.hot_ids.push_back(idx_2); }
 				}
 			}
 		}
 	}
 
-	void SolveGridCollisions(float dt) {
+	// Solves rows [row_begin, row_end). Touches particles in rows row_begin - 1 .. row_end - 1 only.
+	void SolveRows(int row_begin, int row_end, float dt, BandResult& result) {
 
 		// Only check non-redundant cells
-		const std::vector<std::pair<int, int>> neighbors = {
+		static constexpr std::pair<int, int> neighbors[] = {
 			{-1, 0}, // Left
 			{-1, -1}, // Left Up
 			{0, 0}, // Current
@@ -164,7 +862,7 @@ private:
 		};
 
 		// Iterate from bottom to top
-		for (int y = GRID_HEIGHT - 1; y >= 0; y--) {
+		for (int y = row_end - 1; y >= row_begin; y--) {
 
 			for (int x = 0; x < GRID_WIDTH; x++) {
 
@@ -177,14 +875,56 @@ private:
 					int nx = x + dx, ny = y + dy;
 					if (nx < 0 || ny < 0 || nx >= GRID_WIDTH) continue;
 
+					// Contacts between particles that both wait for a later substep are left to that substep
+					if (config.spatial_lod && !tile_due[GetTileIndex(x, y)] && !tile_due[GetTileIndex(nx, ny)]) continue;
+
 					auto& other = collision_grid.GetCell(ny * GRID_WIDTH + nx);
 
-					SolveCells(curr, other, dt);
+					SolveCells(curr, other, dt, result);
 				}
 			}
 		}
 	}
 
+	// The grid is cut into horizontal bands. Even bands are solved in parallel first, then odd ones,
+	// so two bands running at the same time never share a particle.
+	void SolveGridCollisions(float dt) {
+
+		int band_rows = DETERMINISTIC_BAND_ROWS;
+
+		// Fewer, larger bands mean less scheduling overhead but the solve order then follows the thread count
+		if (!config.deterministic)
+			band_rows = std::max(1, GRID_HEIGHT / (pool->GetThreadCount() * 2));
+
+		const int band_count = (GRID_HEIGHT + band_rows - 1) / band_rows;
+
+		if ((int)band_results.size() < band_count)
+			band_results.resize(band_count);
+
+		for (int phase = 0; phase < 2; phase++) {
+
+			pool->Dispatch((band_count - phase + 1) / 2, [&](int task) {
+
+				int band = phase + task * 2;
+				SolveRows(band * band_rows, std::min((band + 1) * band_rows, GRID_HEIGHT), dt, band_results[band]);
+			});
+		}
+
+		// Merged in band order, so the hot set doesn't depend on the scheduling
+		for (int band = 0; band < band_count; band++) {
+
+			BandResult& result = band_results[band];
+
+			hot_ids.insert(hot_ids.end(), result.hot_ids.begin(), result.hot_ids.end());
+			penetration_sum += result.penetration_sum;
+			contacts += result.contacts;
+
+			result.hot_ids.clear();
+			result.penetration_sum = 0.0;
+			result.contacts = 0;
+		}
+	}
+
 	int FindParticleIDIndex(const CollisionCell& cell, int id) {
 
 		int index = -1;
@@ -203,195 +943,1035 @@ private:
 
 	void UpdateObjects(float dt) {
 
+		pool->ParallelFor((int)particles.size(), 256, [&](int begin, int end) {
+
+			for (int i = begin; i < end; i++)
+				particles[i].Update(dt);
+		});
+
+		// Cell lists are rebuilt serially so their order (and so the contact order) stays reproducible
 		for (auto& particle : particles) {
 
-			int curr_grid_position_x = particles_grid_positions[particle.id].first, curr_grid_position_y = particles_grid_positions[particle.id].second;
-			particle.Update(dt);
+			sf::Vector2f displacement = particle.position - particle.last_position;
+			stats.max_displacement = std::max(stats.max_displacement, displacement.x * displacement.x + displacement.y * displacement.y);
 
-			int grid_position_x = (int)particle.position.x / CELL_SIZE;
-			int grid_position_y = (int)particle.position.y / CELL_SIZE;
+			RebinParticle(particle);
+		}
+	}
 
-			particles_grid_positions[particle.id].first = grid_position_x;
-			particles_grid_positions[particle.id].second = grid_position_y;
+	void RebinParticle(Particle& particle) {
 
-			// Check if grid indices are within bounds
-			if (curr_grid_position_x < 0 || curr_grid_position_y < 0 || curr_grid_position_x >= GRID_WIDTH || curr_grid_position_y >= GRID_HEIGHT ||
-				grid_position_x < 0 || grid_position_y < 0 || grid_position_x >= GRID_WIDTH || grid_position_y >= GRID_HEIGHT) {
-				continue;
-			}
+		int curr_grid_position_x = particles_grid_positions[particle.id].first, curr_grid_position_y = particles_grid_positions[particle.id].second;
 
-			// If grid positions are not the same, update cells
-			if (curr_grid_position_x != grid_position_x || curr_grid_position_y != grid_position_y) {
+		// Clamped rather than skipped: with few substeps a particle can end a substep past the border
+		// before SolveBorderCollisions pulls it back, and skipping it left its id in a stale cell
+		int grid_position_x = std::clamp((int)particle.position.x / CELL_SIZE, 0, GRID_WIDTH - 1);
+		int grid_position_y = std::clamp((int)particle.position.y / CELL_SIZE, 0, GRID_HEIGHT - 1);
 
-				CollisionCell& pre_update = collision_grid.cells[curr_grid_position_y * GRID_WIDTH + curr_grid_position_x];
-				CollisionCell& post_update = collision_grid.cells[grid_position_y * GRID_WIDTH + grid_position_x];
+		particles_grid_positions[particle.id].first = grid_position_x;
+		particles_grid_positions[particle.id].second = grid_position_y;
 
-				int index = FindParticleIDIndex(pre_update, particle.id);
+		// If grid positions are not the same, update cells
+		if (curr_grid_position_x != grid_position_x || curr_grid_position_y != grid_position_y) {
 
-				// Only erase if the id was found
-				if (index != -1)
-					pre_update.particle_ids.erase(pre_update.particle_ids.begin() + index);
+			CollisionCell& pre_update = collision_grid.cells[curr_grid_position_y * GRID_WIDTH + curr_grid_position_x];
+			CollisionCell& post_update = collision_grid.cells[grid_position_y * GRID_WIDTH + grid_position_x];
 
-				post_update.particle_ids.push_back(particle.id);
-			}
+			int index = FindParticleIDIndex(pre_update, particle.id);
+
+			// Only erase if the id was found
+			if (index != -1)
+				pre_update.particle_ids.erase(pre_update.particle_ids.begin() + index);
+
+			post_update.particle_ids.push_back(particle.id);
+
+			// Entering a heat source cell
+			if (!is_hot[particle.id] && heat_sources.Lookup(particle.position) > 0.f)
+				MarkHot(particle.id);
 		}
 	}
 
 
-	void UpdateVA() {
+	int GetTileIndex(int cell_x, int cell_y) const {
 
-		for (int i = 0; i < particles.size(); i++) {
+		return (cell_y / LOD_TILE_CELLS) * LOD_TILES_X + cell_x / LOD_TILE_CELLS;
+	}
 
-			int id = i * 3;
-			sf::Vector2f pos = particles[i].position;
-			Particle& particle = particles[i];
-			float radius = particle.radius;
+	// Once per frame. A tile is active if it holds a hot particle or one moving faster than LOD_QUIET_SPEED.
+	// Tiles next to an active one run at full rate too, so the flame never pushes into a tile that's waiting.
+	void ClassifyTiles() {
 
+		tile_rate.resize(LOD_TILES_X * LOD_TILES_Y);
+		tile_due.resize(LOD_TILES_X * LOD_TILES_Y);
+		tile_distance.assign(LOD_TILES_X * LOD_TILES_Y, LOD_TILES_X + LOD_TILES_Y);
 
-			// Change radius depending on temperature
-			if (particles.size() >= MAX_PARTICLES) {
+		for (const auto& particle : particles) {
 
-				if (FIRE) {
+			sf::Vector2f velocity = (particle.position - particle.last_position) / (float)last_steps[particle.id];
 
-					radius = LerpRadius(0.f, RENDER_RADIUS, (particle.temperature / 1500.f));
+			if (is_hot[particle.id] || velocity.x * velocity.x + velocity.y * velocity.y > LOD_QUIET_SPEED * LOD_QUIET_SPEED)
+				tile_distance[GetTileIndex(particles_grid_positions[particle.id].first, particles_grid_positions[particle.id].second)] = 0;
+		}
+
+		// Chebyshev distance transform, one forward and one backward pass
+		for (int y = 0; y < LOD_TILES_Y; y++) {
+
+			for (int x = 0; x < LOD_TILES_X; x++) {
+
+				int& distance = tile_distance[y * LOD_TILES_X + x];
 
-					if (radius < RENDER_RADIUS / 4.f)
-						radius = 0.f;
+				if (x > 0) distance = std::min(distance, tile_distance[y * LOD_TILES_X + x - 1] + 1);
+				if (y > 0) {
+
+					for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, LOD_TILES_X - 1); nx++)
+						distance = std::min(distance, tile_distance[(y - 1) * LOD_TILES_X + nx] + 1);
 				}
 			}
+		}
 
-			va[id].position = pos + sf::Vector2f(-radius, -radius);
-			va[id + 1].position = pos + sf::Vector2f(radius, -radius);
-			va[id + 2].position = pos + sf::Vector2f(0.f, radius);
+		for (int y = LOD_TILES_Y - 1; y >= 0; y--) {
 
-			va[id].texCoords = sf::Vector2f(0.f, 0.f);
-			va[id + 1].texCoords = sf::Vector2f(400.f, 0.f);
-			va[id + 2].texCoords = sf::Vector2f(200.f, 400.f);
+			for (int x = LOD_TILES_X - 1; x >= 0; x--) {
 
-			va[id].color = particle.color;
-			va[id + 1].color = particle.color;
-			va[id + 2].color = particle.color;
+				int& distance = tile_distance[y * LOD_TILES_X + x];
+
+				if (x < LOD_TILES_X - 1) distance = std::min(distance, tile_distance[y * LOD_TILES_X + x + 1] + 1);
+				if (y < LOD_TILES_Y - 1) {
+
+					for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, LOD_TILES_X - 1); nx++)
+						distance = std::min(distance, tile_distance[(y + 1) * LOD_TILES_X + nx] + 1);
+				}
+			}
 		}
-	}
 
+		stats.full_rate_tiles = stats.half_rate_tiles = stats.quarter_rate_tiles = 0;
 
-	void InitTextures() {
+		for (int i = 0; i < LOD_TILES_X * LOD_TILES_Y; i++) {
 
-		sceneTexture.create(WINDOW_WIDTH, WINDOW_HEIGHT);
-		brightnessTexture.create(WINDOW_WIDTH, WINDOW_HEIGHT);
-		blurTextureH.create(WINDOW_WIDTH, WINDOW_HEIGHT);
-		blurTextureV.create(WINDOW_WIDTH, WINDOW_HEIGHT);
-		finalTexture.create(WINDOW_WIDTH, WINDOW_HEIGHT);
+			if (tile_distance[i] <= 1) { tile_rate[i] = 1; stats.full_rate_tiles++; }
+			else if (tile_distance[i] <= LOD_HALF_RATE_DISTANCE) { tile_rate[i] = 2; stats.half_rate_tiles++; }
+			else { tile_rate[i] = 4; stats.quarter_rate_tiles++; }
+		}
 	}
 
-	void InitShaders() {
+	// Marks the tiles integrated in this substep and gathers their particles in id order, so it's reproducible
+	void GatherDueParticles() {
 
-		brightExtract.loadFromFile("BrightnessExtraction.frag", sf::Shader::Fragment);
-		blurH.loadFromFile("GaussianHorizontal.frag", sf::Shader::Fragment);
-		blurV.loadFromFile("GaussianVertical.frag", sf::Shader::Fragment);
-		combine.loadFromFile("CombineBlur.frag", sf::Shader::Fragment);
-		pixelate.loadFromFile("Pixelation.frag", sf::Shader::Fragment);
+		for (int tile = 0; tile < LOD_TILES_X * LOD_TILES_Y; tile++)
+			tile_due[tile] = (substep_counter + 1) % tile_rate[tile] == 0;
 
+		due_ids.clear();
 
-		blurH.setUniform("resolution", (float)WINDOW_WIDTH);
-		blurV.setUniform("resolution", (float)WINDOW_HEIGHT);
-		pixelate.setUniform("resolution", sf::Vector2f((float)WINDOW_WIDTH, (float)WINDOW_HEIGHT));
-		pixelate.setUniform("pixelSize", 5.f);
+		for (int id = 0; id < (int)particles.size(); id++) {
+
+			if (tile_due[GetTileIndex(particles_grid_positions[id].first, particles_grid_positions[id].second)])
+				due_ids.push_back(id);
+		}
 	}
 
-public:
+	// Gravity, borders and integration for the due particles only. A particle that waited covers all the substeps
+	// since its last update in one step, with the gravity and buoyancy it would have accumulated over them.
+	// Particles that switch tiles or rates in between still get the right step, since it's counted per particle.
+	void UpdateDueObjects(float dt) {
 
-	CollisionGrid collision_grid;
+		pool->ParallelFor((int)due_ids.size(), 256, [&](int begin, int end) {
 
-	Solver() {
+			for (int i = begin; i < end; i++) {
 
-		collision_grid.cells.resize(GRID_HEIGHT * GRID_WIDTH);
+				const int id = due_ids[i];
+				Particle& particle = particles[id];
+				const int steps = (int)(substep_counter + 1 - last_update[id]);
 
-		LoadTexture("circle.png");
+				particle.Accelerate({ gravity.x, gravity.y + buoyancy[id] });
+				SolveBorderCollision(particle);
+				particle.Update(dt * (float)steps, (float)steps / (float)last_steps[id]);
 
-		va.resize(MAX_PARTICLES * 3);
+				last_update[id] = substep_counter + 1;
+				last_steps[id] = (uint8_t)steps;
+			}
+		});
 
-		InitTextures();
-		InitShaders();
-	}
+		for (int id : due_ids) {
 
-	void Spawn(sf::Vector2f position) {
+			sf::Vector2f displacement = (particles[id].position - particles[id].last_position) / (float)last_steps[id];
+			stats.max_displacement = std::max(stats.max_displacement, displacement.x * displacement.x + displacement.y * displacement.y);
 
-		if(particles.size() < MAX_PARTICLES)
-			AddParticle(position + sf::Vector2f((float)(rand() % 2), 0.f));
+			RebinParticle(particles[id]);
+		}
 	}
 
-	void SetPixelated() {
+	// Sizes the vertex array for particle_count particles. TexCoords never change, so they're only written here.
+	void ReserveVertices(int particle_count) {
+
+		const int old_count = (int)va.getVertexCount() / 3;
+
+		if (particle_count <= old_count) return;
+
+		va.resize((size_t)particle_count * 3);
+
+		for (int i = old_count; i < particle_count; i++) {
+
+			int id = i * 3;
+
+			va[id].texCoords = sf::Vector2f(0.f, 0.f);
+			va[id + 1].texCoords = sf::Vector2f(400.f, 0.f);
+			va[id + 2].texCoords = sf::Vector2f(200.f, 400.f);
+		}
+	}
+
+	// Id of the k-th particle the vertex build goes through. All of them in id order, or culled_ids.
+	int GetDrawId(int k) const {
+
+		return culling ? culled_ids[k] : k;
+	}
+
+	// Ranges below are in the order of the vertex build, see GetDrawId
+	int CountVisible(const RenderSnapshot& snapshot, int begin, int end) const {
+
+		int visible = 0;
+
+		for (int k = begin; k < end; k++)
+			visible += GetRenderRadius(snapshot, GetDrawId(k)) > 0.f;
+
+		return visible;
+	}
+
+	// Writes the visible particles of [begin, end) packed from triangle slot out onwards
+	template <typename ColorFunction>
+	void BuildSpeciesVertices(const RenderSnapshot& snapshot, int begin, int end, int& out, ColorFunction to_color) {
+
+		for (int k = begin; k < end; k++) {
+
+			const int i = GetDrawId(k);
+			float radius = GetRenderRadius(snapshot, i);
+
+			if (radius <= 0.f) continue;
+
+			int id = out++ * 3;
+			sf::Vector2f pos = snapshot.positions[i];
+			sf::Color color = snapshot.filled ? to_color(snapshot.temperatures[i]) : sf::Color::White;
+
+			va[id].position = pos + sf::Vector2f(-radius, -radius);
+			va[id + 1].position = pos + sf::Vector2f(radius, -radius);
+			va[id + 2].position = pos + sf::Vector2f(0.f, radius);
+
+			va[id].color = color;
+			va[id + 1].color = color;
+			va[id + 2].color = color;
+		}
+	}
+
+	// Split at the species ranges, so the color choice is made per range instead of per particle
+	void BuildVertices(const RenderSnapshot& snapshot, int begin, int end, int out) {
+
+		const int smoke_begin = std::clamp(draw_species_begin[(int)Species::Smoke], begin, end);
+		const int smoke_end = std::clamp(draw_species_begin[(int)Species::Inert], smoke_begin, end);
+
+		BuildSpeciesVertices(snapshot, begin, smoke_begin, out, TemperatureToColor);
+		BuildSpeciesVertices(snapshot, smoke_begin, smoke_end, out, SmokeColor);
+		BuildSpeciesVertices(snapshot, smoke_end, end, out, TemperatureToColor);
+	}
+
+	// Same packing as BuildVertices, one record per particle
+	void BuildCompactVertices(const RenderSnapshot& snapshot, int begin, int end, int out) {
+
+		const int smoke_begin = draw_species_begin[(int)Species::Smoke];
+		const int smoke_end = draw_species_begin[(int)Species::Inert];
+
+		auto to_fixed = [](float value, float scale) {
+
+			return (int16_t)std::clamp(value * scale + 0.5f, 0.f, 32767.f);
+		};
+
+		for (int k = begin; k < end; k++) {
+
+			const int i = GetDrawId(k);
+			float radius = GetRenderRadius(snapshot, i);
+
+			if (radius <= 0.f) continue;
+
+			CompactVertex& vertex = compact_vertices[out++];
+			vertex.x = to_fixed(snapshot.positions[i].x, COMPACT_POSITION_SCALE);
+			vertex.y = to_fixed(snapshot.positions[i].y, COMPACT_POSITION_SCALE);
+			vertex.temperature = to_fixed(std::min(snapshot.temperatures[i], MAX_TEMPERATURE), COMPACT_TEMPERATURE_SCALE);
+			vertex.radius = to_fixed(radius, COMPACT_RADIUS_SCALE);
+
+			if (k >= smoke_begin && k < smoke_end)
+				vertex.radius = -vertex.radius;
+		}
+	}
+
+	// Collects the particles of the tiles the camera overlaps into culled_ids. Returns false when every tile is
+	// overlapped, or the snapshot has no tile lists, and the vertex build then goes through all particles.
+	bool CullToCamera(const RenderSnapshot& snapshot) {
+
+		if (snapshot.tile_begin.empty()) return false;
+
+		// Widened by the largest sprite, and by a cell since the grid is rebinned before the last collision pass
+		const float margin = std::max(RENDER_RADIUS, PARTICLE_RADIUS) + CELL_SIZE;
+		const float tile_size = (float)(CULL_TILE_CELLS * CELL_SIZE);
+		const sf::FloatRect view = camera.GetVisibleRect();
+
+		const int x0 = std::max(0, (int)std::floor((view.left - margin) / tile_size));
+		const int y0 = std::max(0, (int)std::floor((view.top - margin) / tile_size));
+		const int x1 = std::min(CULL_TILES_X - 1, (int)std::floor((view.left + view.width + margin) / tile_size));
+		const int y1 = std::min(CULL_TILES_Y - 1, (int)std::floor((view.top + view.height + margin) / tile_size));
+
+		if (x0 == 0 && y0 == 0 && x1 == CULL_TILES_X - 1 && y1 == CULL_TILES_Y - 1) return false;
+
+		// Marked in a bitmap and read back in id order, so the sprites overlap like in the full build and the species
+		// stay in contiguous ranges. Cheaper than sorting, reading back costs a word per 64 particles.
+		culled_bits.assign((snapshot.particle_count + 63) / 64, 0);
+		int culled_count = 0;
+
+		// The tiles of a row are contiguous in tile_ids
+		for (int y = y0; y <= y1; y++) {
+
+			const int begin = snapshot.tile_begin[y * CULL_TILES_X + x0], end = snapshot.tile_begin[y * CULL_TILES_X + x1 + 1];
+
+			for (int t = begin; t < end; t++)
+				culled_bits[snapshot.tile_ids[t] >> 6] |= 1ULL << (snapshot.tile_ids[t] & 63);
+
+			culled_count += end - begin;
+		}
+
+		culled_ids.resize(culled_count);
+		int out = 0;
+
+		for (int word = 0; word < (int)culled_bits.size(); word++) {
+
+			for (uint64_t bits = culled_bits[word]; bits != 0; bits &= bits - 1)
+				culled_ids[out++] = word * 64 + std::countr_zero(bits);
+		}
+
+		culled_ids.resize(out);
+
+		return true;
+	}
+
+	// Needs vertex shaders, returns false to fall back to sf::Vertex triangles
+	bool InitCompactVertices() {
+
+		if (!sf::Shader::isAvailable()) {
+
+			std::cerr << "Compact vertices need shaders, falling back to sf::Vertex\n";
+			return false;
+		}
+
+		// SFML prints the compile log
+		if (!gpu->compact_shader.loadFromFile("CompactParticle.vert", "CompactParticle.frag")) {
+
+			std::cerr << "Failed to load CompactParticle.vert/.frag, falling back to sf::Vertex\n";
+			return false;
+		}
+
+		// Fire gradient on top, smoke below, looked up like TemperatureToColor and SmokeColor
+		sf::Image palette;
+		palette.create(PALETTE_SIZE, 2);
+
+		for (int i = 0; i < PALETTE_SIZE; i++) {
+
+			palette.setPixel(i, 0, sf::Color(PALETTE[i].r, PALETTE[i].g, PALETTE[i].b));
+			palette.setPixel(i, 1, SmokeColor(MAX_TEMPERATURE * (float)i / (float)(PALETTE_SIZE - 1)));
+		}
+
+		if (!gpu->palette_texture.loadFromImage(palette)) return false;
+
+		gpu->palette_texture.setSmooth(false);
+
+		gpu->compact_shader.setUniform("resolution", sf::Vector2f((float)WINDOW_WIDTH, (float)WINDOW_HEIGHT));
+		gpu->compact_shader.setUniform("positionScale", COMPACT_POSITION_SCALE);
+		gpu->compact_shader.setUniform("radiusScale", COMPACT_RADIUS_SCALE);
+		gpu->compact_shader.setUniform("temperatureScale", 1.f / (COMPACT_TEMPERATURE_SCALE * MAX_TEMPERATURE));
+		gpu->compact_shader.setUniform("diskCenter", sf::Vector2f(SPRITE_DISK_X, SPRITE_DISK_Y));
+		gpu->compact_shader.setUniform("diskRadius", SPRITE_DISK_RADIUS);
+		gpu->compact_shader.setUniform("palette", gpu->palette_texture);
+		gpu->compact_shader.setUniform("paletteSize", (float)PALETTE_SIZE);
+
+		return true;
+	}
+
+	// Raw OpenGL, SFML can't draw custom vertex formats. Client arrays are OpenGL 1.1, so no buffer functions need loading;
+	// the driver copies the 8 bytes per particle on the draw.
+	void DrawCompactVertices(sf::RenderTarget& target, bool filled) {
+
+		gpu->compact_shader.setUniform("filled", filled ? 1.f : 0.f);
+		gpu->compact_shader.setUniform("viewCenter", camera.GetView().getCenter());
+		gpu->compact_shader.setUniform("viewSize", camera.GetView().getSize());
+
+		target.pushGLStates();
+		sf::Shader::bind(&gpu->compact_shader);
+
+		glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+		glEnable(GL_POINT_SPRITE);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glDisableClientState(GL_COLOR_ARRAY);
+
+		glVertexPointer(2, GL_SHORT, sizeof(CompactVertex), &compact_vertices[0].x);
+		glTexCoordPointer(2, GL_SHORT, sizeof(CompactVertex), &compact_vertices[0].temperature);
+		glDrawArrays(GL_POINTS, 0, visible_count);
+
+		glDisable(GL_POINT_SPRITE);
+		glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+
+		sf::Shader::bind(nullptr);
+		target.popGLStates();
+	}
+
+	// sf::VertexBuffer only takes interleaved sf::Vertex, so the static texCoords are uploaded along with the rest
+	void UploadVertices(size_t vertex_count) {
+
+		if (gpu->vertex_buffer.getVertexCount() < vertex_count && !gpu->vertex_buffer.create(vertex_count)) {
+
+			std::cerr << "Failed to create the vertex buffer, falling back to the vertex array\n";
+			use_vertex_buffer = false;
+			return;
+		}
+
+		gpu->vertex_buffer.update(&va[0], vertex_count, 0);
+	}
+
+	void InitTextures() {
+
+		gpu->sceneTexture.create(WINDOW_WIDTH, WINDOW_HEIGHT);
+		gpu->sceneTexture.setSmooth(true); // Averages the scene down into the first bloom level instead of skipping pixels
+
+		InitBloomTextures();
+	}
+
+	// The bloom only holds blurred light, so every level is smooth and the combine pass upscales the first one
+	void InitBloomTextures() {
+
+		unsigned int width = WINDOW_WIDTH / (2 * bloom_downscale), height = WINDOW_HEIGHT / (2 * bloom_downscale);
+
+		gpu->bloom_chain.clear();
+
+		for (int i = 0; i <= bloom_levels; i++) {
+
+			gpu->bloom_chain.push_back(std::make_unique<sf::RenderTexture>());
+			gpu->bloom_chain.back()->create(std::max(1u, width), std::max(1u, height));
+			gpu->bloom_chain.back()->setSmooth(true); // The dual filter taps sit between texels
+
+			width /= 2;
+			height /= 2;
+		}
+
+		for (sf::RenderTexture& history : gpu->bloomHistory) {
+
+			history.create(gpu->bloom_chain[0]->getSize().x, gpu->bloom_chain[0]->getSize().y);
+			history.setSmooth(true);
+		}
+
+		history_valid = false;
+	}
+
+	// Blends the freshly computed bloom into the history with weight, 1 replaces it
+	void BlendBloomHistory(float weight) {
+
+		sf::RenderTexture& target = gpu->bloomHistory[1 - history_index];
+
+		gpu->blend.setUniform("current", gpu->bloom_chain[0]->getTexture());
+		gpu->blend.setUniform("previous", gpu->bloomHistory[history_index].getTexture());
+		gpu->blend.setUniform("weight", weight);
+
+		target.clear();
+		target.draw(sf::Sprite(gpu->bloom_chain[0]->getTexture()), &gpu->blend);
+		target.display();
+
+		history_index = 1 - history_index;
+	}
+
+	// Stretches source over target, halfPixel is half a source texel in texture coordinates
+	void DrawBloomLevel(const sf::Texture& source, sf::RenderTexture& target, sf::Shader& shader) {
+
+		sf::Vector2u source_size = source.getSize(), target_size = target.getSize();
+
+		shader.setUniform("texture", source);
+		shader.setUniform("halfPixel", sf::Vector2f(0.5f / source_size.x, 0.5f / source_size.y));
+
+		sf::Sprite sprite(source);
+		sprite.setScale((float)target_size.x / source_size.x, (float)target_size.y / source_size.y);
+
+		target.clear();
+		target.draw(sprite, &shader);
+		target.display();
+	}
+
+	void InitShaders() {
+
+		gpu->downsample.loadFromFile("DualDownsample.frag", sf::Shader::Fragment);
+		gpu->upsample.loadFromFile("DualUpsample.frag", sf::Shader::Fragment);
+		gpu->combine.loadFromFile("CombineBlur.frag", sf::Shader::Fragment);
+		gpu->blend.loadFromFile("BloomBlend.frag", sf::Shader::Fragment);
+
+
+		gpu->combine.setUniform("resolution", sf::Vector2f((float)WINDOW_WIDTH, (float)WINDOW_HEIGHT));
+	}
+
+public:
+
+	CollisionGrid collision_grid;
+
+	Solver(const SolverConfig& solver_config = {})
+		: config(solver_config),
+		rng(solver_config.seed),
+		pool(MakePool(solver_config.thread_count, solver_config.affinity_mask)),
+		render_pool(MakePool(solver_config.render_thread_count, solver_config.render_affinity_mask))
+	{
+
+		collision_grid.cells.resize(GRID_HEIGHT * GRID_WIDTH);
+
+		heat_sources.Resize(GRID_WIDTH, GRID_HEIGHT, (float)CELL_SIZE);
+
+		// No particles yet, so the hot set needs no rebuild
+		if (config.heat_map_path.empty() || !heat_sources.LoadFromFile(config.heat_map_path))
+			ResetHeatSources();
+
+		SetThermalStepsPerFrame(config.thermal_steps_per_frame);
+
+		thermal_grid.Resize(WORLD_WIDTH, WORLD_HEIGHT, THERMAL_CELL_SIZE);
+
+		ReserveVertices(MAX_PARTICLES);
+
+		bloom_levels = std::clamp(config.bloom_levels, 1, MAX_BLOOM_LEVELS);
+		bloom_interval = std::clamp(config.bloom_interval, 1, MAX_BLOOM_INTERVAL);
+
+		if (config.headless) return;
+
+		gpu = std::make_unique<GpuResources>();
+
+		use_compact_vertices = config.compact_vertices && InitCompactVertices();
+
+		// Falls back to the texture when shaders aren't there
+		use_procedural_sprite = config.procedural_sprite && gpu->sprite.loadFromFile("ParticleSprite.frag", sf::Shader::Fragment);
+
+		if (use_procedural_sprite) {
+
+			gpu->sprite.setUniform("center", sf::Vector2f(SPRITE_DISK_X, SPRITE_DISK_Y));
+			gpu->sprite.setUniform("radius", SPRITE_DISK_RADIUS);
+		}
+		else {
+
+			LoadTexture("circle.png");
+		}
+
+		InitTextures();
+		InitShaders();
+
+		use_vertex_buffer = !config.vertex_array && sf::VertexBuffer::isAvailable();
+	}
+
+	void Spawn(sf::Vector2f position) {
+
+		// Stay inside the grid, AddParticle doesn't check
+		position.x = std::clamp(position.x, 0.f, (float)WORLD_WIDTH - 2.f);
+		position.y = std::clamp(position.y, 0.f, (float)WORLD_HEIGHT - 1.f);
+
+		if((int)particles.size() < particle_cap)
+			AddParticle(position + sf::Vector2f((float)rng.NextInt(2), 0.f));
+	}
+
+	void SetSeed(uint64_t seed) {
+
+		config.seed = seed;
+		rng.Seed(seed);
+	}
+
+	void SetThreadCount(int thread_count) {
+
+		config.thread_count = std::max(1, thread_count);
+		pool = MakePool(config.thread_count, config.affinity_mask);
+	}
+
+	void SetRenderThreadCount(int thread_count) {
+
+		config.render_thread_count = std::max(1, thread_count);
+		render_pool = MakePool(config.render_thread_count, config.render_affinity_mask);
+	}
+
+	void SetDeterministic(bool deterministic) {
+
+		config.deterministic = deterministic;
+	}
+
+	const SolverConfig& GetConfig() const { return config; }
+
+	void SetThermalStepsPerFrame(int steps) {
+
+		config.thermal_steps_per_frame = steps;
+
+		int stable_steps = GetStableThermalSteps(steps);
+
+		if (steps > 0 && stable_steps != steps)
+			std::cerr << "Thermal rate of " << steps << " per frame is unstable, using " << stable_steps << '\n';
+	}
+
+	int GetHotParticleCount() const { return (int)hot_ids.size(); }
+
+	const SolverStats& GetStats() const { return stats; }
+
+	// Mean height above the window bottom of particles at or above min_temperature, 0 if there are none
+	float GetAverageFlameHeight(float min_temperature) const {
+
+		double height_sum = 0.0;
+		int count = 0;
+
+		for (const auto& particle : particles) {
+
+			if (temperatures[particle.id] < min_temperature) continue;
+
+			height_sum += WORLD_HEIGHT - particle.position.y;
+			count++;
+		}
+
+		return count > 0 ? (float)(height_sum / count) : 0.f;
+	}
+
+	// Call from the thread that will drive UpdateSolver
+	void ApplySimThreadSettings() const {
+
+		SetCurrentThreadAffinity(config.sim_affinity_mask);
+		SetCurrentThreadPriority(config.sim_realtime, config.sim_nice);
+	}
+
+	void SetPixelated() {
 
 		pixelated = !pixelated;
 	}
 
+	// Render-side, call from the thread calling Render
+	void SetBloomQuality(int downscale, int levels, int interval) {
+
+		levels = std::clamp(levels, 1, MAX_BLOOM_LEVELS);
+		downscale = std::max(1, downscale);
+		bloom_interval = std::clamp(interval, 1, MAX_BLOOM_INTERVAL);
+
+		if (downscale != bloom_downscale || levels != bloom_levels) {
+
+			bloom_downscale = downscale;
+			bloom_levels = levels;
+
+			if (gpu) InitBloomTextures();
+		}
+	}
+
+	size_t GetUploadBytes() const { return upload_bytes; }
+
+	int GetVisibleCount() const { return visible_count; }
+
+	// Render side only, like the pixelation. Mouse input has to go through Camera::ToWorld.
+	Camera& GetCamera() { return camera; }
+
+	bool IsCulling() const { return culling; }
+
+	bool IsUsingVertexBuffer() const { return use_vertex_buffer; }
+
+	int GetBloomDownscale() const { return bloom_downscale; }
+
+	int GetBloomLevels() const { return bloom_levels; }
+
+	int GetBloomInterval() const { return bloom_interval; }
+
+	// Only exact on the solver thread, other threads may see the previous cap until queued commands ran
+	int GetParticleCap() const { return particle_cap; }
+
+	// Largest thermal dt for which the explicit updates can't overshoot: the cooling and heating lerps
+	// must stay within [0, 1] and the grid stencil weight within 0.5
+	float GetMaxStableThermalDt() const {
+
+		float max_dt = 1.f;
+
+		for (const ThermalParams& params : species_params)
+			max_dt = std::min(max_dt, 1.f / std::max(params.cooling_rate, params.heating_rate));
+		max_dt = std::min(max_dt, 0.5f / THERMAL_DIFFUSION_RATE);
+		max_dt = std::min(max_dt, 1.f / THERMAL_GATHER_RATE);
+
+		return max_dt;
+	}
+
+	// Clamps the requested rate to [1, sub_steps] and raises it until the thermal dt is stable.
+	// With the current constants the limit is the grid diffusion's 0.025 s, above the 1/60 s frame, so every rate passes;
+	// the raise only guards against faster rates in future constant changes.
+	int GetStableThermalSteps(int requested) const {
+
+		int steps = requested <= 0 ? sub_steps : std::clamp(requested, 1, sub_steps);
+
+		while (steps < sub_steps && m_dt / (float)steps > GetMaxStableThermalDt())
+			steps++;
+
+		return steps;
+	}
+
+	// Scales the substep count by how far the last frame's motion and overlap were from their targets.
+	// Increases apply at once, decreases one step per frame so the count doesn't oscillate.
+	// A substep limit replaces the fixed count, or caps the adaptive range.
+	int ChooseSubSteps() const {
+
+		if (!config.adaptive_substeps)
+			return substep_limit > 0 ? substep_limit : SUB_STEPS;
+
+		int wanted = sub_steps;
+
+		if (stats.sub_steps > 0) {
+
+			// Both shrink roughly in proportion to the substep length
+			float ratio = std::max(stats.max_displacement / TARGET_DISPLACEMENT, stats.mean_penetration / TARGET_PENETRATION);
+
+			if (ratio > 1.f)
+				wanted = (int)std::ceil(sub_steps * ratio);
+			else if (sub_steps > 1 && ratio * sub_steps / (sub_steps - 1) < 1.f)
+				wanted = sub_steps - 1; // Only if one substep less would still be within the targets
+		}
+
+		const int upper = GetMaxSubSteps();
+
+		return std::clamp(wanted, std::min(std::max(1, config.min_substeps), upper), upper);
+	}
+
+	// Top of the adaptive range, lowered by a SetSubSteps limit
+	int GetMaxSubSteps() const {
+
+		int upper = std::max(config.min_substeps, config.max_substeps);
+
+		if (substep_limit > 0)
+			upper = std::min(upper, substep_limit);
+
+		return upper;
+	}
+
+	// Verlet stores velocity as the last substep's displacement, so it has to follow a change of sub_dt
+	void SetSubSteps(int new_sub_steps) {
+
+		if (new_sub_steps == sub_steps) return;
+
+		const float scale = (float)sub_steps / (float)new_sub_steps;
+
+		pool->ParallelFor((int)particles.size(), 256, [&](int begin, int end) {
+
+			for (int i = begin; i < end; i++)
+				particles[i].last_position = particles[i].position - (particles[i].position - particles[i].last_position) * scale;
+		});
+
+		sub_steps = new_sub_steps;
+		sub_dt = m_dt / (float)sub_steps;
+	}
+
+	// Heat changes far slower than positions, so it can be integrated less often than the mechanics
 	void UpdateSolver() {
 
+		SetSubSteps(ChooseSubSteps());
+
+		stats.max_displacement = 0.f;
+		penetration_sum = 0.0;
+		contacts = 0;
+
+		const int thermal_steps = GetStableThermalSteps(config.thermal_steps_per_frame);
+		const float thermal_dt = m_dt / (float)thermal_steps;
+
+		if (config.spatial_lod)
+			ClassifyTiles();
+
 		for (int i = 0; i < sub_steps; i++) {
 
-			ApplyGravity();
+			DrainCommands();
+
+			if (config.spatial_lod)
+				GatherDueParticles();
+
 			SolveGridCollisions(sub_dt);
 
-			if(particles.size() >= MAX_PARTICLES)
-				ApplyTemperature(sub_dt);
+			// True on thermal_steps of the sub_steps substeps, evenly spaced
+			if ((i + 1) * thermal_steps / sub_steps != i * thermal_steps / sub_steps) {
+
+				if (config.thermal_mode != ThermalMode::Contact)
+					ExchangeHeatGrid(thermal_dt);
+
+				if (filled)
+					ApplyTemperature(thermal_dt);
+			}
+
+			if (config.spatial_lod) {
+
+				UpdateDueObjects(sub_dt);
+			}
+			else {
+
+				ApplyGravity();
+				SolveBorderCollisions();
+				UpdateObjects(sub_dt);
+			}
+
+			// After the integration, so LOD's due list isn't renamed under it
+			if (config.species)
+				ConvertSpecies();
+
+			substep_counter++;
+		}
+
+		stats.max_displacement = std::sqrt(stats.max_displacement);
+		stats.mean_penetration = contacts > 0 ? (float)(penetration_sum / contacts) : 0.f;
+		stats.sub_steps = sub_steps;
+		stats.thermal_steps = thermal_steps;
+		stats.hot_particles = (int)hot_ids.size();
+	}
+
+	// Only visible particles get vertices. Blocks count their visible particles first,
+	// a prefix sum over the counts gives each block its output offset, then every block writes its own slice.
+	// When the camera shows part of the world, only the particles of the tiles it overlaps are gone through.
+	void UpdateVA() {
+
+		const RenderSnapshot& snapshot = snapshots[front_snapshot];
+
+		culling = CullToCamera(snapshot);
+
+		const int draw_count = culling ? (int)culled_ids.size() : snapshot.particle_count;
+		const int block_count = (draw_count + VERTEX_BLOCK - 1) / VERTEX_BLOCK;
+
+		for (int s = 0; s <= SPECIES_COUNT; s++) {
+
+			draw_species_begin[s] = culling
+				? (int)(std::lower_bound(culled_ids.begin(), culled_ids.end(), snapshot.species_begin[s]) - culled_ids.begin())
+				: snapshot.species_begin[s];
+		}
+
+		if (use_compact_vertices) {
+
+			if ((int)compact_vertices.size() < draw_count)
+				compact_vertices.resize(draw_count);
+		}
+		else {
 
-			SolveBorderCollisions();
-			UpdateObjects(sub_dt);
+			ReserveVertices(draw_count);
 		}
+
+		block_offsets.assign(block_count + 1, 0);
+
+		render_pool->Dispatch(block_count, [&](int block) {
+
+			block_offsets[block + 1] = CountVisible(snapshot, block * VERTEX_BLOCK, std::min((block + 1) * VERTEX_BLOCK, draw_count));
+		});
+
+		for (int block = 0; block < block_count; block++)
+			block_offsets[block + 1] += block_offsets[block];
+
+		render_pool->Dispatch(block_count, [&](int block) {
+
+			const int begin = block * VERTEX_BLOCK, end = std::min((block + 1) * VERTEX_BLOCK, draw_count);
+
+			if (use_compact_vertices)
+				BuildCompactVertices(snapshot, begin, end, block_offsets[block]);
+			else
+				BuildVertices(snapshot, begin, end, block_offsets[block]);
+		});
+
+		visible_count = block_offsets[block_count];
+	}
+
+	// Lets the vertex build be driven without a running solver, e.g. by the benchmark
+	RenderSnapshot& GetFrontSnapshot() { return snapshots[front_snapshot]; }
+
+	// Groups the ids of the collision cells by cull tile, counted per tile row first, then copied behind a prefix sum.
+	// Empty cells cost a size check, so this stays well below the position copy.
+	void PublishTileLists(RenderSnapshot& snapshot) {
+
+		auto for_each_cell = [&](int tile_x, int tile_y, auto&& function) {
+
+			const int x_end = std::min((tile_x + 1) * CULL_TILE_CELLS, GRID_WIDTH);
+			const int y_end = std::min((tile_y + 1) * CULL_TILE_CELLS, GRID_HEIGHT);
+
+			for (int y = tile_y * CULL_TILE_CELLS; y < y_end; y++)
+				for (int x = tile_x * CULL_TILE_CELLS; x < x_end; x++)
+					function(collision_grid.cells[y * GRID_WIDTH + x]);
+		};
+
+		snapshot.tile_begin.assign(CULL_TILES_X * CULL_TILES_Y + 1, 0);
+
+		pool->Dispatch(CULL_TILES_Y, [&](int tile_y) {
+
+			for (int tile_x = 0; tile_x < CULL_TILES_X; tile_x++) {
+
+				int count = 0;
+				for_each_cell(tile_x, tile_y, [&](const CollisionCell& cell) { count += (int)cell.particle_ids.size(); });
+
+				snapshot.tile_begin[tile_y * CULL_TILES_X + tile_x + 1] = count;
+			}
+		});
+
+		for (int tile = 0; tile < CULL_TILES_X * CULL_TILES_Y; tile++)
+			snapshot.tile_begin[tile + 1] += snapshot.tile_begin[tile];
+
+		snapshot.tile_ids.resize(snapshot.tile_begin.back());
+
+		pool->Dispatch(CULL_TILES_Y, [&](int tile_y) {
+
+			for (int tile_x = 0; tile_x < CULL_TILES_X; tile_x++) {
+
+				int out = snapshot.tile_begin[tile_y * CULL_TILES_X + tile_x];
+
+				for_each_cell(tile_x, tile_y, [&](const CollisionCell& cell) {
+
+					std::copy(cell.particle_ids.begin(), cell.particle_ids.end(), snapshot.tile_ids.begin() + out);
+					out += (int)cell.particle_ids.size();
+				});
+			}
+		});
+	}
+
+	// Copies the current particle state into the back snapshot. Safe to call while the front one is being rendered.
+	void PublishSnapshot() {
+
+		RenderSnapshot& snapshot = snapshots[1 - front_snapshot];
+		const int count = (int)particles.size();
+
+		snapshot.positions.resize(count);
+		snapshot.radii.resize(count);
+		snapshot.temperatures.resize(count);
+
+		pool->ParallelFor(count, 1024, [&](int begin, int end) {
+
+			for (int i = begin; i < end; i++) {
+
+				snapshot.positions[i] = particles[i].position;
+				snapshot.radii[i] = particles[i].radius;
+				snapshot.temperatures[i] = temperatures[i];
+			}
+		});
+
+		snapshot.particle_count = count;
+		snapshot.filled = filled;
+		snapshot.species_begin = species_begin;
+		snapshot.stats = stats;
+
+		PublishTileLists(snapshot);
 	}
 
+	// Must only be called while neither PublishSnapshot nor Render is running
+	void SwapSnapshots() {
+
+		front_snapshot = 1 - front_snapshot;
+	}
+
+	// Renders the front snapshot, i.e. the state published before the last SwapSnapshots
 	void Render(sf::RenderWindow* window) {
 
 		UpdateVA();
 
-		sceneTexture.clear();
+		const size_t vertex_count = use_compact_vertices ? 0 : (size_t)visible_count * 3;
+
+		if (use_vertex_buffer && vertex_count > 0)
+			UploadVertices(vertex_count);
+
+		// The vertex array is copied to the driver on every draw, so both paths send the same amount per frame.
+		// The buffer is updated in place instead of being re-specified.
+		upload_bytes = use_compact_vertices ? (size_t)visible_count * sizeof(CompactVertex) : vertex_count * sizeof(sf::Vertex);
+
+		gpu->sceneTexture.clear();
+		gpu->sceneTexture.setView(camera.GetView());
 		sf::RenderStates states;
-		states.texture = &particle_texture;
-		sceneTexture.draw(va, states);
-		sceneTexture.display();
 
+		if (use_procedural_sprite)
+			states.shader = &gpu->sprite;
+		else
+			states.texture = &gpu->particle_texture;
+
+		if (use_compact_vertices) {
+
+			if (visible_count > 0 && gpu->sceneTexture.setActive(true))
+				DrawCompactVertices(gpu->sceneTexture, GetFrontSnapshot().filled);
+		}
+		else if (use_vertex_buffer)
+			gpu->sceneTexture.draw(gpu->vertex_buffer, 0, vertex_count, states);
+		else if (vertex_count > 0)
+			gpu->sceneTexture.draw(&va[0], vertex_count, sf::Triangles, states);
+
+		gpu->sceneTexture.display();
+
+
+		// The bloom changes much slower than the particles move, so with an interval above 1 it's only
+		// recomputed every bloom_interval frames and blended into a history the frames in between show as is
+		const bool update_bloom = bloom_interval == 1 || !history_valid || render_frame % bloom_interval == 0;
+		render_frame++;
+
+		if (update_bloom) {
+
+			// Dual filter: down the chain, then back up with each level overwritten by the blurred one below it.
+			// The first pass reads the scene and drops the dark fetches, so there is no separate brightness pass.
+			for (int i = 0; i <= bloom_levels; i++) {
+
+				gpu->downsample.setUniform("threshold", i == 0 ? BLOOM_THRESHOLD : -1.f);
+				DrawBloomLevel(i == 0 ? gpu->sceneTexture.getTexture() : gpu->bloom_chain[i - 1]->getTexture(), *gpu->bloom_chain[i], gpu->downsample);
+			}
 
-		brightnessTexture.clear();
-		brightExtract.setUniform("texture", sceneTexture.getTexture());
-		sf::Sprite sceneSprite(sceneTexture.getTexture());
-		brightnessTexture.draw(sceneSprite, &brightExtract);
-		brightnessTexture.display();
+			for (int i = bloom_levels - 1; i >= 0; i--) {
 
+				gpu->upsample.setUniform("gain", i == 0 ? BLOOM_GAIN : 1.f);
+				DrawBloomLevel(gpu->bloom_chain[i + 1]->getTexture(), *gpu->bloom_chain[i], gpu->upsample);
+			}
 
-		blurTextureH.clear();
-		blurH.setUniform("texture", brightnessTexture.getTexture());
-		sf::Sprite brightSprite(brightnessTexture.getTexture());
-		blurTextureH.draw(brightSprite, &blurH);
-		blurTextureH.display();
+			if (bloom_interval > 1) {
 
+				BlendBloomHistory(history_valid ? BLOOM_HISTORY_WEIGHT : 1.f);
+				history_valid = true;
+			}
+			else {
 
-		blurTextureV.clear();
-		blurV.setUniform("texture", blurTextureH.getTexture());
-		sf::Sprite blurSprite(blurTextureH.getTexture());
-		blurTextureV.draw(blurSprite, &blurV);
-		blurTextureV.display();
+				history_valid = false; // Stale by the time the interval goes up again
+			}
+		}
 
+		const sf::Texture& bloom = bloom_interval > 1 ? gpu->bloomHistory[history_index].getTexture() : gpu->bloom_chain[0]->getTexture();
 
-		finalTexture.clear();
-		combine.setUniform("originalScene", sceneTexture.getTexture());
-		combine.setUniform("blurredBloom", blurTextureV.getTexture());
-		finalTexture.draw(sceneSprite, &combine);
-		finalTexture.display();
 
+		// Combine and pixelate in one pass, straight to the window
+		gpu->combine.setUniform("originalScene", gpu->sceneTexture.getTexture());
+		gpu->combine.setUniform("blurredBloom", bloom);
+		gpu->combine.setUniform("pixelSize", pixelated ? PIXEL_SIZE : 1.f);
 
-		pixelate.setUniform("texture", finalTexture.getTexture());
 		window->clear();
-		sf::Sprite finalSprite(finalTexture.getTexture());
+		sf::Sprite sceneSprite(gpu->sceneTexture.getTexture());
+		window->draw(sceneSprite, &gpu->combine); // Final render pass
+	}
 
-		if (pixelated)
-			window->draw(finalSprite, &pixelate); // Final render pass
-		else
-			window->draw(finalSprite, &combine);
+	// Only one thread may push. Returns false and drops the command if the queue is full, so input never blocks.
+	bool PushCommand(const SolverCommand& command) {
+
+		return commands.Push(command);
 	}
 
+	int GetParticleCount() const { return particle_count.load(); }
+
 	std::vector<Particle>& GetParticles() {
 
 		return particles;
 	}
+
+	// FNV-1a over the simulated state, used to check that two runs are bit-identical
+	uint64_t GetStateHash() const {
+
+		uint64_t hash = 14695981039346656037ULL;
+
+		auto hash_bytes = [&](const void* data, size_t size) {
+
+			const unsigned char* bytes = (const unsigned char*)data;
+
+			for (size_t i = 0; i < size; i++) {
+
+				hash ^= bytes[i];
+				hash *= 1099511628211ULL;
+			}
+		};
+
+		for (const auto& particle : particles) {
+
+			hash_bytes(&particle.position, sizeof(particle.position));
+			hash_bytes(&particle.last_position, sizeof(particle.last_position));
+			hash_bytes(&temperatures[particle.id], sizeof(float));
+		}
+
+		return hash;
+	}
 };
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <algorithm>
+#include "ThermalKernel.h"
+
+// Particles are stored sorted by species, each species in one contiguous range of ids.
+// Conversions only go to the next species, so moving a particle is a swap with the last one of its range.
+enum class Species {
+
+	Fuel, // Holds heat and barely rises, ignites at IGNITION_TEMPERATURE
+	Flame, // Cools slowly and rises fast, turns to smoke below EXTINCTION_TEMPERATURE
+	Smoke, // Rises and cools quickly, settles as inert once cold
+	Inert // The original particle, heats and glows but never burns
+};
+
+constexpr int SPECIES_COUNT = 4;
+
+constexpr float IGNITION_TEMPERATURE = 700.f;
+constexpr float EXTINCTION_TEMPERATURE = 400.f;
+
+constexpr float SMOKE_BRIGHTNESS = 120.f; // Gray level of the hottest smoke
+
+// Indexed by Species
+inline const std::array<ThermalParams, SPECIES_COUNT> SPECIES_THERMAL_PARAMS = { {
+	{ 1.5f, 4.f, 0.005f },
+	{ 1.2f, 4.f, 0.02f },
+	{ 3.5f, 1.f, 0.03f },
+	{}
+} };
+
+inline sf::Color SmokeColor(float temperature) {
+
+	uint8_t gray = (uint8_t)(std::clamp(temperature / MAX_TEMPERATURE, 0.f, 1.f) * SMOKE_BRIGHTNESS);
+
+	return sf::Color(gray, gray, gray);
+}
\ No newline at end of file
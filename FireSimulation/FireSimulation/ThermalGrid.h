@@ -0,0 +1,131 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include "SFML/System/Vector2.hpp"
+
+// Coarse Eulerian grid for heat transport. Particles splat their temperature into it,
+// the grid diffuses, and particles gather the result back.
+// Heat and particle mass are diffused separately and divided afterwards, so empty cells
+// don't act as cold sinks along the edge of the flame.
+class ThermalGrid {
+
+private:
+	int width = 0;
+	int height = 0;
+	float cell_size = 1.f;
+
+	std::vector<float> heat;
+	std::vector<float> mass;
+	std::vector<float> scratch_heat;
+	std::vector<float> scratch_mass;
+
+	// 3-tap [w, 1 - 2w, w] along x, edges are clamped so nothing leaks out of the domain
+	void DiffuseHorizontal(const std::vector<float>& src, std::vector<float>& dst, float weight) const {
+
+		const float center = 1.f - 2.f * weight;
+
+		for (int y = 0; y < height; y++) {
+
+			const float* in = &src[y * width];
+			float* out = &dst[y * width];
+
+			out[0] = in[0] * (center + weight) + in[1] * weight;
+
+			for (int x = 1; x < width - 1; x++)
+				out[x] = in[x] * center + (in[x - 1] + in[x + 1]) * weight;
+
+			out[width - 1] = in[width - 1] * (center + weight) + in[width - 2] * weight;
+		}
+	}
+
+	// Same stencil along y. The inner loop runs over contiguous x, so it vectorizes.
+	void DiffuseVertical(const std::vector<float>& src, std::vector<float>& dst, float weight) const {
+
+		const float center = 1.f - 2.f * weight;
+
+		for (int y = 0; y < height; y++) {
+
+			const float* in = &src[y * width];
+			const float* up = &src[std::max(y - 1, 0) * width];
+			const float* down = &src[std::min(y + 1, height - 1) * width];
+			float* out = &dst[y * width];
+
+			for (int x = 0; x < width; x++)
+				out[x] = in[x] * center + (up[x] + down[x]) * weight;
+		}
+	}
+
+	// Bilinear weights around position, using cell centers as sample points
+	void GetSampleCells(sf::Vector2f position, int& x0, int& y0, int& x1, int& y1, float& fx, float& fy) const {
+
+		float gx = std::clamp(position.x / cell_size - 0.5f, 0.f, (float)(width - 1));
+		float gy = std::clamp(position.y / cell_size - 0.5f, 0.f, (float)(height - 1));
+
+		x0 = (int)gx;
+		y0 = (int)gy;
+		x1 = std::min(x0 + 1, width - 1);
+		y1 = std::min(y0 + 1, height - 1);
+		fx = gx - (float)x0;
+		fy = gy - (float)y0;
+	}
+
+public:
+
+	void Resize(int domain_width, int domain_height, float thermal_cell_size) {
+
+		cell_size = thermal_cell_size;
+		width = std::max(2, (int)((domain_width + cell_size - 1) / cell_size));
+		height = std::max(2, (int)((domain_height + cell_size - 1) / cell_size));
+
+		heat.assign(width * height, 0.f);
+		mass.assign(width * height, 0.f);
+		scratch_heat.assign(width * height, 0.f);
+		scratch_mass.assign(width * height, 0.f);
+	}
+
+	void Clear() {
+
+		std::fill(heat.begin(), heat.end(), 0.f);
+		std::fill(mass.begin(), mass.end(), 0.f);
+	}
+
+	void Splat(sf::Vector2f position, float temperature) {
+
+		int x = std::clamp((int)(position.x / cell_size), 0, width - 1);
+		int y = std::clamp((int)(position.y / cell_size), 0, height - 1);
+
+		heat[y * width + x] += temperature;
+		mass[y * width + x] += 1.f;
+	}
+
+	// weight is the fraction exchanged with each neighbour per pass, at most 0.5 for stability
+	void Diffuse(float weight) {
+
+		weight = std::clamp(weight, 0.f, 0.5f);
+
+		DiffuseHorizontal(heat, scratch_heat, weight);
+		DiffuseHorizontal(mass, scratch_mass, weight);
+		DiffuseVertical(scratch_heat, heat, weight);
+		DiffuseVertical(scratch_mass, mass, weight);
+	}
+
+	// Mass-weighted bilinear temperature at position, 0 where no particle contributed
+	float Sample(sf::Vector2f position) const {
+
+		int x0, y0, x1, y1;
+		float fx, fy;
+		GetSampleCells(position, x0, y0, x1, y1, fx, fy);
+
+		auto bilerp = [&](const std::vector<float>& field) {
+
+			float top = field[y0 * width + x0] + (field[y0 * width + x1] - field[y0 * width + x0]) * fx;
+			float bottom = field[y1 * width + x0] + (field[y1 * width + x1] - field[y1 * width + x0]) * fx;
+
+			return top + (bottom - top) * fy;
+		};
+
+		float sampled_mass = bilerp(mass);
+
+		return sampled_mass > 1e-6f ? bilerp(heat) / sampled_mass : 0.f;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include "Particle.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#include <immintrin.h>
+#define THERMAL_KERNEL_SSE 1
+#else
+#define THERMAL_KERNEL_SSE 0
+#endif
+
+struct ThermalParams {
+
+	float cooling_rate = 2.5f;
+	float heating_rate = 4.f; // Scaled per particle by the heat source intensity under it
+	float buoyancy = 0.015f;
+};
+
+// The original per-particle TemperatureBehavior, with the bottom band test generalized to a heat source intensity.
+// Kept as the reference the batched kernel is checked against.
+static void ReferenceTemperatureBehavior(float& temperature, float heat, float& acceleration_y, const ThermalParams& params, float dt) {
+
+	temperature = std::lerp(temperature, 0.f, params.cooling_rate * dt);
+
+	if (heat > 0.f)
+		temperature = std::lerp(temperature, MAX_TEMPERATURE, params.heating_rate * heat * dt);
+
+	temperature = std::clamp(temperature, 0.f, MAX_TEMPERATURE);
+	acceleration_y += -std::pow(temperature, 2.f) * params.buoyancy * (temperature / MAX_TEMPERATURE);
+}
+
+// Cooling, heating by the source intensity in heat[], clamping and buoyancy over SoA arrays without branches.
+// A zero intensity adds exactly 0, so unheated particles only cool.
+// The scalar tail does the same operations in the same order as the SIMD lanes,
+// so results don't depend on where a range starts or ends.
+static void ThermalKernel(float* temperature, const float* heat, float* buoyancy, int count, const ThermalParams& params, float dt) {
+
+	const float cooling = params.cooling_rate * dt;
+	const float heating = params.heating_rate * dt;
+	const float buoyancy_factor = -params.buoyancy / MAX_TEMPERATURE; // -T^2 * b * T / MAX == T^3 * (-b / MAX)
+
+	int i = 0;
+
+#if THERMAL_KERNEL_SSE
+	const __m128 cooling4 = _mm_set1_ps(cooling);
+	const __m128 heating4 = _mm_set1_ps(heating);
+	const __m128 max4 = _mm_set1_ps(MAX_TEMPERATURE);
+	const __m128 zero4 = _mm_setzero_ps();
+	const __m128 factor4 = _mm_set1_ps(buoyancy_factor);
+
+	for (; i + 4 <= count; i += 4) {
+
+		__m128 t = _mm_loadu_ps(temperature + i);
+
+		t = _mm_sub_ps(t, _mm_mul_ps(t, cooling4));
+
+		t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(max4, t), _mm_mul_ps(heating4, _mm_loadu_ps(heat + i))));
+
+		t = _mm_min_ps(_mm_max_ps(t, zero4), max4);
+
+		_mm_storeu_ps(temperature + i, t);
+		_mm_storeu_ps(buoyancy + i, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), factor4));
+	}
+#endif
+
+	for (; i < count; i++) {
+
+		float t = temperature[i];
+
+		t = t - t * cooling;
+
+		t = t + (MAX_TEMPERATURE - t) * (heating * heat[i]);
+
+		t = std::min(std::max(t, 0.f), MAX_TEMPERATURE);
+
+		temperature[i] = t;
+		buoyancy[i] = ((t * t) * t) * buoyancy_factor;
+	}
+}
\ No newline at end of file
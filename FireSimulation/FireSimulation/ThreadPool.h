@@ -0,0 +1,275 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+static void CpuRelax() {
+
+#if defined(_M_X64) || defined(__x86_64__)
+	_mm_pause();
+#else
+	std::this_thread::yield();
+#endif
+}
+
+// Returns the index of the n-th set bit of mask, cycling, or -1 for an empty mask
+static int NthCpuInMask(uint64_t mask, int n) {
+
+	int bits = 0;
+
+	for (int cpu = 0; cpu < 64; cpu++)
+		if (mask & (1ULL << cpu)) bits++;
+
+	if (bits == 0) return -1;
+
+	n %= bits;
+
+	for (int cpu = 0; cpu < 64; cpu++) {
+
+		if (!(mask & (1ULL << cpu))) continue;
+		if (n-- == 0) return cpu;
+	}
+
+	return -1;
+}
+
+// Restricts the calling thread to the CPUs in mask. A zero mask leaves it to the OS.
+static void SetCurrentThreadAffinity(uint64_t mask) {
+
+	if (mask == 0) return;
+
+#ifdef _WIN32
+	if (!SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)mask))
+		std::cerr << "Failed to set thread affinity\n";
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for (int cpu = 0; cpu < 64; cpu++)
+		if (mask & (1ULL << cpu)) CPU_SET(cpu, &set);
+
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+		std::cerr << "Failed to set thread affinity\n";
+#endif
+}
+
+// Realtime uses SCHED_FIFO (TIME_CRITICAL on Windows) and needs privileges, otherwise nice is applied to this thread only
+static void SetCurrentThreadPriority(bool realtime, int nice) {
+
+#ifdef _WIN32
+	int priority = THREAD_PRIORITY_NORMAL;
+
+	if (realtime) priority = THREAD_PRIORITY_TIME_CRITICAL;
+	else if (nice <= -10) priority = THREAD_PRIORITY_HIGHEST;
+	else if (nice < 0) priority = THREAD_PRIORITY_ABOVE_NORMAL;
+	else if (nice >= 10) priority = THREAD_PRIORITY_LOWEST;
+	else if (nice > 0) priority = THREAD_PRIORITY_BELOW_NORMAL;
+
+	if (priority != THREAD_PRIORITY_NORMAL && !SetThreadPriority(GetCurrentThread(), priority))
+		std::cerr << "Failed to set thread priority\n";
+#elif defined(__linux__)
+	if (realtime) {
+
+		sched_param param{};
+		param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 1;
+
+		if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+			std::cerr << "Failed to enable SCHED_FIFO (missing CAP_SYS_NICE?)\n";
+	}
+	else if (nice != 0) {
+
+		if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice) != 0)
+			std::cerr << "Failed to set thread niceness\n";
+	}
+#endif
+}
+
+struct ThreadPoolConfig {
+
+	int thread_count = 1;
+	uint64_t affinity_mask = 0; // Worker i is pinned to the i-th CPU in the mask, 0 = no pinning
+	int spin_count = 2000; // Busy-wait iterations before a waiting thread parks on the condition variable
+};
+
+// Fixed set of worker threads. The calling thread takes part in every dispatch,
+// so a pool of N threads owns N - 1 workers.
+class ThreadPool {
+
+private:
+	std::vector<std::thread> workers;
+	ThreadPoolConfig config;
+
+	std::mutex mutex;
+	std::condition_variable work_cv;
+	std::condition_variable done_cv;
+
+	const std::function<void(int)>* task = nullptr;
+	int task_count = 0;
+	std::atomic<int> next_task{ 0 };
+	std::atomic<int> pending_workers{ 0 };
+
+	std::atomic<unsigned long long> generation{ 0 };
+	std::atomic<bool> stopping{ false };
+
+	// Spins for up to spin_count iterations, returns false if the condition still doesn't hold
+	template <typename Condition>
+	bool SpinUntil(Condition condition) const {
+
+		for (int i = 0; i < config.spin_count; i++) {
+
+			if (condition()) return true;
+			CpuRelax();
+		}
+
+		return condition();
+	}
+
+	void RunTasks() {
+
+		int index;
+
+		while ((index = next_task.fetch_add(1)) < task_count)
+			(*task)(index);
+	}
+
+	void WorkerLoop(int worker_index) {
+
+		// The first CPU of the mask is only left free. The pool never pins the thread that dispatches,
+		// for the simulation thread that's --sim-affinity.
+		if (config.affinity_mask != 0)
+			SetCurrentThreadAffinity(1ULL << NthCpuInMask(config.affinity_mask, worker_index + 1));
+
+		unsigned long long seen_generation = 0;
+
+		while (true) {
+
+			auto has_work = [&] { return stopping.load() || generation.load() != seen_generation; };
+
+			if (!SpinUntil(has_work)) {
+
+				std::unique_lock<std::mutex> lock(mutex);
+				work_cv.wait(lock, has_work);
+			}
+
+			if (stopping) return;
+
+			seen_generation = generation.load();
+
+			RunTasks();
+
+			if (pending_workers.fetch_sub(1) == 1) {
+
+				std::lock_guard<std::mutex> lock(mutex);
+				done_cv.notify_one();
+			}
+		}
+	}
+
+public:
+
+	ThreadPool(const ThreadPoolConfig& pool_config = {})
+		: config(pool_config)
+	{
+
+		for (int i = 1; i < config.thread_count; i++)
+			workers.emplace_back(&ThreadPool::WorkerLoop, this, i - 1);
+	}
+
+	~ThreadPool() {
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+
+		work_cv.notify_all();
+
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int GetThreadCount() const { return (int)workers.size() + 1; }
+
+	// Runs fn(0) .. fn(count - 1) across the pool and returns once all of them finished.
+	// Which thread runs which index is up to the scheduler, so tasks must not depend on it.
+	void Dispatch(int count, const std::function<void(int)>& fn) {
+
+		if (count <= 0) return;
+
+		if (workers.empty() || count == 1) {
+
+			for (int i = 0; i < count; i++)
+				fn(i);
+
+			return;
+		}
+
+		task = &fn;
+		task_count = count;
+		next_task = 0;
+		pending_workers = (int)workers.size();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			generation++;
+		}
+
+		work_cv.notify_all();
+
+		RunTasks();
+
+		// This is the barrier between solver stages, spinning first keeps short stages off the scheduler
+		auto all_done = [&] { return pending_workers.load() == 0; };
+
+		if (!SpinUntil(all_done)) {
+
+			std::unique_lock<std::mutex> lock(mutex);
+			done_cv.wait(lock, all_done);
+		}
+	}
+
+	// Splits [0, count) into contiguous ranges of at least min_chunk elements
+	void ParallelFor(int count, int min_chunk, const std::function<void(int, int)>& fn) {
+
+		if (count <= 0) return;
+
+		int chunk_count = std::min(GetThreadCount() * 4, (count + min_chunk - 1) / min_chunk);
+		chunk_count = std::max(chunk_count, 1);
+
+		int chunk_size = (count + chunk_count - 1) / chunk_count;
+
+		Dispatch(chunk_count, [&](int chunk) {
+
+			int begin = chunk * chunk_size;
+			int end = std::min(begin + chunk_size, count);
+
+			if (begin < end)
+				fn(begin, end);
+		});
+	}
+};
\ No newline at end of file
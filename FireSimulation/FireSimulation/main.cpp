@@ -1,10 +1,102 @@
 #include "Simulation.h"
+#include "Benchmark.h"
+#include "Headless.h"
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
 
 
 
-int main() {
+int main(int argc, char** argv) {
 
-	Simulation simulation;
+	SolverConfig config;
+	SimulationConfig simulation_config;
+	HeadlessConfig headless_config;
+	bool benchmark = false;
+
+	for (int i = 1; i < argc; i++) {
+
+		if (std::strcmp(argv[i], "--benchmark") == 0)
+			benchmark = true;
+		else if (std::strcmp(argv[i], "--nondeterministic") == 0)
+			config.deterministic = false;
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			config.thread_count = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--render-threads") == 0 && i + 1 < argc)
+			config.render_thread_count = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			config.seed = std::strtoull(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--thermal-mode") == 0 && i + 1 < argc) {
+
+			const char* mode = argv[++i];
+			config.thermal_mode = std::strcmp(mode, "grid") == 0 ? ThermalMode::Grid : std::strcmp(mode, "both") == 0 ? ThermalMode::Both : ThermalMode::Contact;
+		}
+		else if (std::strcmp(argv[i], "--thermal-rate") == 0 && i + 1 < argc)
+			config.thermal_steps_per_frame = std::max(0, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--adaptive") == 0)
+			config.adaptive_substeps = true;
+		else if (std::strcmp(argv[i], "--min-substeps") == 0 && i + 1 < argc)
+			config.min_substeps = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--max-substeps") == 0 && i + 1 < argc)
+			config.max_substeps = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--vertex-array") == 0)
+			config.vertex_array = true;
+		else if (std::strcmp(argv[i], "--procedural-sprite") == 0)
+			config.procedural_sprite = true;
+		else if (std::strcmp(argv[i], "--compact-vertices") == 0)
+			config.compact_vertices = true;
+		else if (std::strcmp(argv[i], "--species") == 0)
+			config.species = true;
+		else if (std::strcmp(argv[i], "--bloom-levels") == 0 && i + 1 < argc)
+			config.bloom_levels = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--bloom-interval") == 0 && i + 1 < argc)
+			config.bloom_interval = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--lod") == 0)
+			config.spatial_lod = true;
+		else if (std::strcmp(argv[i], "--heat-map") == 0 && i + 1 < argc)
+			config.heat_map_path = argv[++i];
+		else if (std::strcmp(argv[i], "--affinity") == 0 && i + 1 < argc)
+			config.affinity_mask = std::strtoull(argv[++i], nullptr, 0);
+		else if (std::strcmp(argv[i], "--render-affinity") == 0 && i + 1 < argc)
+			config.render_affinity_mask = std::strtoull(argv[++i], nullptr, 0);
+		else if (std::strcmp(argv[i], "--sim-affinity") == 0 && i + 1 < argc)
+			config.sim_affinity_mask = std::strtoull(argv[++i], nullptr, 0);
+		else if (std::strcmp(argv[i], "--realtime") == 0)
+			config.sim_realtime = true;
+		else if (std::strcmp(argv[i], "--nice") == 0 && i + 1 < argc)
+			config.sim_nice = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--spin") == 0 && i + 1 < argc)
+			config.spin_count = std::max(0, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc)
+			simulation_config.frame_budget_ms = (float)std::atof(argv[++i]);
+		else if (std::strcmp(argv[i], "--headless") == 0 && i + 1 < argc)
+			headless_config.frames = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--resolution") == 0 && i + 1 < argc)
+			std::sscanf(argv[++i], "%dx%d", &headless_config.width, &headless_config.height);
+		else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			headless_config.output_path = argv[++i];
+		else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+			simulation_config.capture_path = headless_config.capture_path = argv[++i];
+	}
+
+	if (benchmark) {
+
+		config.headless = true; // Nothing is drawn through OpenGL, so the benchmarks run without a display too
+		bool passed = RunThermalKernelCheck(config.seed);
+		passed = RunGovernorCheck(config) && passed;
+		RunDeterminismBenchmark(config);
+		RunVertexBuildBenchmark(config);
+		RunCullingBenchmark(config);
+		RunThermalRateBenchmark(config);
+		RunSoftwareRenderBenchmark(config);
+
+		return passed ? 0 : 1;
+	}
+
+	if (headless_config.frames > 0)
+		return RunHeadless(config, headless_config) ? 0 : 1;
+
+	Simulation simulation(config, simulation_config);
 
 	simulation.Update();
 